@@ -0,0 +1,155 @@
+#include "calendar.h"
+
+// Two spans with the same offset can only be joined if they are closer than
+// this; time zone rules never change twice within a week
+#define MAX_SPAN_EXTENSION_IN_SECONDS (7 * SECONDS_PER_DAY)
+#define NUMBER_OF_OFFSET_SPANS 2
+
+// A range of times that localtime() has confirmed share one UTC offset
+typedef struct {
+  time_t from;
+  time_t to;
+  int32_t offset;
+  bool valid;
+} OffsetSpan;
+
+static OffsetSpan offset_spans[NUMBER_OF_OFFSET_SPANS];
+static int next_span_to_replace;
+
+static int32_t today;
+
+static TimeUnits client_tick_units;
+static TickHandler client_tick_handler;
+
+// Static functions
+static int32_t days_from_civil(int year, int month, int day) {
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const int year_of_era = year - era * 400;
+  const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+static int32_t offset_from_localtime(time_t time) {
+  struct tm *date_time = localtime(&time);
+  int32_t day = days_from_civil(date_time->tm_year + 1900, date_time->tm_mon + 1, date_time->tm_mday);
+  int32_t local_time = day * SECONDS_PER_DAY + date_time->tm_hour * 60 * 60 + date_time->tm_min * 60 + date_time->tm_sec;
+  return local_time - time;
+}
+
+static int32_t offset_for_time(time_t time) {
+  for (int i = 0; i < NUMBER_OF_OFFSET_SPANS; i++) {
+    OffsetSpan span = offset_spans[i];
+    if (span.valid && time >= span.from && time <= span.to) {
+      return span.offset;
+    }
+  }
+
+  int32_t offset = offset_from_localtime(time);
+
+  // Grow a neighbouring span with the same offset, otherwise start a new one
+  for (int i = 0; i < NUMBER_OF_OFFSET_SPANS; i++) {
+    OffsetSpan *span = &offset_spans[i];
+    if (!span->valid || span->offset != offset) {
+      continue;
+    }
+    if (time < span->from && span->from - time <= MAX_SPAN_EXTENSION_IN_SECONDS) {
+      span->from = time;
+      return offset;
+    }
+    if (time > span->to && time - span->to <= MAX_SPAN_EXTENSION_IN_SECONDS) {
+      span->to = time;
+      return offset;
+    }
+  }
+
+  offset_spans[next_span_to_replace] = (OffsetSpan){
+    .from = time,
+    .to = time,
+    .offset = offset,
+    .valid = true,
+  };
+  next_span_to_replace = (next_span_to_replace + 1) % NUMBER_OF_OFFSET_SPANS;
+
+  return offset;
+}
+
+static void refresh() {
+  time_t now = time(NULL);
+
+  // A time zone change moves the offset for a time that is already cached
+  int32_t offset = offset_from_localtime(now);
+  if (offset != offset_for_time(now)) {
+    memset(offset_spans, 0, sizeof(offset_spans));
+    next_span_to_replace = 0;
+  }
+
+  today = calendar_day_for_time(now);
+}
+
+static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+  if (units_changed & (HOUR_UNIT | DAY_UNIT)) {
+    refresh();
+  }
+
+  if (client_tick_handler != NULL && (units_changed & client_tick_units)) {
+    client_tick_handler(tick_time, units_changed);
+  }
+}
+
+static void subscribe() {
+  // DST and time zone changes take effect on the hour
+  tick_timer_service_subscribe(client_tick_units | HOUR_UNIT | DAY_UNIT, tick_handler);
+}
+
+// Non-static functions
+int32_t calendar_day_for_time(time_t time) {
+  return (time + offset_for_time(time)) / SECONDS_PER_DAY;
+}
+
+int calendar_seconds_into_day(time_t time) {
+  return (time + offset_for_time(time)) % SECONDS_PER_DAY;
+}
+
+void calendar_month_day_for_day(int32_t day, int *month, int *day_of_month) {
+  day += 719468;
+  const int era = (day >= 0 ? day : day - 146096) / 146097;
+  const int day_of_era = day - era * 146097;
+  const int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const int month_from_march = (5 * day_of_year + 2) / 153;
+
+  *day_of_month = day_of_year - (153 * month_from_march + 2) / 5 + 1;
+  // Zero-based, like tm_mon
+  *month = month_from_march < 10 ? month_from_march + 2 : month_from_march - 10;
+}
+
+void calendar_month_day_for_time(time_t time, int *month, int *day_of_month) {
+  calendar_month_day_for_day(calendar_day_for_time(time), month, day_of_month);
+}
+
+bool calendar_is_today(time_t time) {
+  return calendar_day_for_time(time) == today;
+}
+
+void calendar_subscribe_tick(TimeUnits tick_units, TickHandler handler) {
+  client_tick_units = tick_units;
+  client_tick_handler = handler;
+  subscribe();
+}
+
+void calendar_unsubscribe_tick() {
+  client_tick_units = 0;
+  client_tick_handler = NULL;
+  subscribe();
+}
+
+void calendar_init() {
+  refresh();
+  subscribe();
+}
+
+void calendar_deinit() {
+  tick_timer_service_unsubscribe();
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#include <pebble.h>
+#pragma once
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+int32_t calendar_day_for_time(time_t time);
+int calendar_seconds_into_day(time_t time);
+void calendar_month_day_for_day(int32_t day, int *month, int *day_of_month);
+void calendar_month_day_for_time(time_t time, int *month, int *day_of_month);
+bool calendar_is_today(time_t time);
+
+void calendar_subscribe_tick(TimeUnits tick_units, TickHandler handler);
+void calendar_unsubscribe_tick();
+
+void calendar_init();
+void calendar_deinit();
\ No newline at end of file
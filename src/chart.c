@@ -0,0 +1,325 @@
+#include <pebble.h>
+#include "chart.h"
+#include "store.h"
+#include "calendar.h"
+
+// Contractions over the last few hours on a timeline: each one is a bar as
+// tall as it was long, so the gaps between bars are the intervals. The bars
+// are drawn from per-bucket aggregates into an off-screen bitmap, which is
+// all a frame has to blit. A store change only collects and redraws the
+// buckets its records fall in, found from the store's change log, and a new
+// bucket coming in shifts the ones there are.
+
+#define BUCKET_SECONDS (5 * 60)
+#define NUMBER_OF_BUCKETS 48
+#define BUCKET_WIDTH 3
+#define BAR_WIDTH 2
+
+#define CHART_WIDTH (NUMBER_OF_BUCKETS * BUCKET_WIDTH)
+#define CHART_HEIGHT 120
+#define BASELINE_Y (CHART_HEIGHT - 8)
+#define HOUR_MARK_HEIGHT 4
+// A contraction this long fills the height of the chart
+#define FULL_BAR_DURATION_IN_SECONDS 120
+
+// Contractions that started in one bucket
+typedef struct {
+  uint8_t count;
+  uint16_t longest_duration_in_seconds;
+} ChartBucket;
+
+static Window *window;
+
+static TextLayer *title_layer;
+static char title_text[] = "PAST 4 HOURS";
+
+static BitmapLayer *chart_layer;
+static GBitmap *chart_bitmap;
+
+// Oldest first; the last one is the bucket now falls in
+static ChartBucket buckets[NUMBER_OF_BUCKETS];
+static int32_t newest_bucket_number;
+
+// Store the buckets were last collected from: its version, where its
+// change log was, and its oldest record, which archiving can take away
+// without logging a change
+static uint32_t rendered_data_version;
+static uint32_t rendered_sync_sequence;
+static time_t rendered_oldest_start_time;
+
+// Static functions
+static int32_t bucket_number_for_time(time_t time) {
+  return time / BUCKET_SECONDS;
+}
+
+static void fill_column(int x, int from_y, int to_y, bool white) {
+  uint8_t *data = gbitmap_get_data(chart_bitmap);
+  uint16_t bytes_per_row = gbitmap_get_bytes_per_row(chart_bitmap);
+  uint8_t bit = 1 << (x % 8);
+
+  for (int y = from_y; y < to_y; y++) {
+    uint8_t *byte = &data[y * bytes_per_row + x / 8];
+    if (white) {
+      *byte |= bit;
+    } else {
+      *byte &= ~bit;
+    }
+  }
+}
+
+static int bar_height(const ChartBucket *bucket) {
+  if (bucket->count == 0) {
+    return 0;
+  }
+
+  int duration = bucket->longest_duration_in_seconds;
+  if (duration > FULL_BAR_DURATION_IN_SECONDS) {
+    duration = FULL_BAR_DURATION_IN_SECONDS;
+  }
+  // Even the shortest contraction shows up
+  int height = duration * BASELINE_Y / FULL_BAR_DURATION_IN_SECONDS;
+  return height > 0 ? height : 1;
+}
+
+static void draw_bucket(int index) {
+  int bar_top = BASELINE_Y - bar_height(&buckets[index]);
+
+  for (int x = index * BUCKET_WIDTH; x < index * BUCKET_WIDTH + BAR_WIDTH; x++) {
+    fill_column(x, 0, bar_top, true);
+    fill_column(x, bar_top, BASELINE_Y, false);
+  }
+}
+
+// Everything below the bars, with a mark where each hour starts
+static void draw_axis() {
+  uint8_t *data = gbitmap_get_data(chart_bitmap);
+  uint16_t bytes_per_row = gbitmap_get_bytes_per_row(chart_bitmap);
+  memset(&data[BASELINE_Y * bytes_per_row], 0xff, (CHART_HEIGHT - BASELINE_Y) * bytes_per_row);
+
+  for (int x = 0; x < CHART_WIDTH; x++) {
+    fill_column(x, BASELINE_Y, BASELINE_Y + 1, false);
+  }
+
+  int32_t oldest_bucket_number = newest_bucket_number - (NUMBER_OF_BUCKETS - 1);
+  for (int i = 0; i < NUMBER_OF_BUCKETS; i++) {
+    time_t bucket_start = (oldest_bucket_number + i) * BUCKET_SECONDS;
+    if (calendar_seconds_into_day(bucket_start) % (60 * 60) == 0) {
+      fill_column(i * BUCKET_WIDTH, BASELINE_Y + 1, BASELINE_Y + 1 + HOUR_MARK_HEIGHT, false);
+    }
+  }
+}
+
+static void draw_chart() {
+  uint8_t *data = gbitmap_get_data(chart_bitmap);
+  memset(data, 0xff, BASELINE_Y * gbitmap_get_bytes_per_row(chart_bitmap));
+
+  for (int i = 0; i < NUMBER_OF_BUCKETS; i++) {
+    draw_bucket(i);
+  }
+  draw_axis();
+
+  layer_mark_dirty(bitmap_layer_get_layer(chart_layer));
+}
+
+static time_t oldest_start_time() {
+  Contraction contraction;
+  int count = store_number_of_past_contractions();
+  return count > 0 && store_contraction_at_index(count - 1, &contraction) ? contraction.start_time : 0;
+}
+
+// Records are newest first, so only the ones in the chart are read, and
+// none older than the oldest bucket collected. Every bucket is collected
+// when changed is NULL.
+static void collect_buckets(const bool *changed) {
+  int first = 0;
+  while (changed != NULL && first < NUMBER_OF_BUCKETS && !changed[first]) {
+    first++;
+  }
+  for (int i = first; i < NUMBER_OF_BUCKETS; i++) {
+    if (changed == NULL || changed[i]) {
+      memset(&buckets[i], 0, sizeof(ChartBucket));
+    }
+  }
+
+  int32_t oldest_bucket_number = newest_bucket_number - (NUMBER_OF_BUCKETS - 1);
+  Contraction contraction;
+  for (int i = 0; first < NUMBER_OF_BUCKETS && store_contraction_at_index(i, &contraction); i++) {
+    int32_t bucket_number = bucket_number_for_time(contraction.start_time);
+    if (bucket_number < oldest_bucket_number + first) {
+      break;
+    }
+    if (bucket_number > newest_bucket_number || (changed != NULL && !changed[bucket_number - oldest_bucket_number])) {
+      continue;
+    }
+
+    ChartBucket *bucket = &buckets[bucket_number - oldest_bucket_number];
+    if (bucket->count < UINT8_MAX) {
+      bucket->count++;
+    }
+    if (contraction.seconds_elapsed > bucket->longest_duration_in_seconds) {
+      bucket->longest_duration_in_seconds = contraction.seconds_elapsed > UINT16_MAX ? UINT16_MAX : contraction.seconds_elapsed;
+    }
+  }
+
+  rendered_data_version = store_data_version();
+  rendered_sync_sequence = store_sync_sequence();
+  rendered_oldest_start_time = oldest_start_time();
+}
+
+static void rebuild_chart() {
+  newest_bucket_number = bucket_number_for_time(time(NULL));
+  collect_buckets(NULL);
+  draw_chart();
+}
+
+// Marks the buckets holding a record changed since the last collection.
+// False when the change log cannot tell: changes of a transaction not yet
+// committed, a log that no longer goes back that far, all records removed,
+// or archived records that were in the chart.
+static bool mark_changed_buckets(bool *changed) {
+  if (store_sync_sequence() == rendered_sync_sequence || !store_can_sync_from(rendered_sync_sequence)) {
+    return false;
+  }
+
+  int32_t oldest_bucket_number = newest_bucket_number - (NUMBER_OF_BUCKETS - 1);
+  if (oldest_start_time() != rendered_oldest_start_time && bucket_number_for_time(oldest_start_time()) >= oldest_bucket_number) {
+    return false;
+  }
+
+  Change change;
+  for (uint32_t sequence = rendered_sync_sequence; store_next_change(sequence, &change); sequence = change.sequence) {
+    if (change.kind == ChangeRemoveAll) {
+      return false;
+    }
+
+    int32_t bucket_number = bucket_number_for_time(change.start_time);
+    if (bucket_number >= oldest_bucket_number && bucket_number <= newest_bucket_number) {
+      changed[bucket_number - oldest_bucket_number] = true;
+    }
+  }
+  return true;
+}
+
+static void update_changed_buckets() {
+  bool changed[NUMBER_OF_BUCKETS] = { false };
+  if (!mark_changed_buckets(changed)) {
+    rebuild_chart();
+    return;
+  }
+
+  collect_buckets(changed);
+  bool redrawn = false;
+  for (int i = 0; i < NUMBER_OF_BUCKETS; i++) {
+    if (changed[i]) {
+      draw_bucket(i);
+      redrawn = true;
+    }
+  }
+
+  if (redrawn) {
+    layer_mark_dirty(bitmap_layer_get_layer(chart_layer));
+  }
+}
+
+// A bucket coming in starts empty, so moving forward needs no store calls.
+// A clock that went back gets everything collected again.
+static void slide_to_now() {
+  int32_t shift = bucket_number_for_time(time(NULL)) - newest_bucket_number;
+  if (shift == 0) {
+    return;
+  }
+  if (shift < 0) {
+    rebuild_chart();
+    return;
+  }
+
+  if (shift < NUMBER_OF_BUCKETS) {
+    memmove(buckets, &buckets[shift], (NUMBER_OF_BUCKETS - shift) * sizeof(ChartBucket));
+    memset(&buckets[NUMBER_OF_BUCKETS - shift], 0, shift * sizeof(ChartBucket));
+  } else {
+    memset(buckets, 0, sizeof(buckets));
+  }
+  newest_bucket_number += shift;
+  draw_chart();
+}
+
+static void update_chart_if_changed() {
+  slide_to_now();
+  if (rendered_data_version != store_data_version()) {
+    update_changed_buckets();
+  }
+}
+
+// Calendar callbacks
+static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+  slide_to_now();
+}
+
+// Store callbacks
+static void store_changed_handler(uint32_t data_version) {
+  if (window_stack_get_top_window() == window) {
+    update_chart_if_changed();
+  }
+}
+
+// Window handlers
+static void window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect window_frame = layer_get_frame(window_layer);
+
+  const int16_t padding = 6;
+
+  GRect title_frame = GRect(0, 0, window_frame.size.w, 18);
+  title_layer = text_layer_create(title_frame);
+  text_layer_set_text(title_layer, title_text);
+  text_layer_set_font(title_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
+  text_layer_set_text_alignment(title_layer, GTextAlignmentCenter);
+  layer_add_child(window_layer, text_layer_get_layer(title_layer));
+
+  chart_bitmap = gbitmap_create_blank(GSize(CHART_WIDTH, CHART_HEIGHT), GBitmapFormat1Bit);
+
+  GRect chart_frame = GRect((window_frame.size.w - CHART_WIDTH) / 2, title_frame.origin.y + title_frame.size.h + padding, CHART_WIDTH, CHART_HEIGHT);
+  chart_layer = bitmap_layer_create(chart_frame);
+  bitmap_layer_set_bitmap(chart_layer, chart_bitmap);
+  layer_add_child(window_layer, bitmap_layer_get_layer(chart_layer));
+
+  rebuild_chart();
+  store_subscribe(store_changed_handler);
+}
+
+static void window_appear(Window *window) {
+  update_chart_if_changed();
+  calendar_subscribe_tick(MINUTE_UNIT, tick_handler);
+}
+
+static void window_disappear(Window *window) {
+  calendar_unsubscribe_tick();
+}
+
+static void window_unload(Window *window) {
+  store_unsubscribe(store_changed_handler);
+
+  text_layer_destroy(title_layer);
+  bitmap_layer_destroy(chart_layer);
+  gbitmap_destroy(chart_bitmap);
+}
+
+// Non-static functions
+void show_chart() {
+  window_stack_push(window, true);
+}
+
+void chart_init() {
+  window = window_create();
+
+  window_set_window_handlers(window, (WindowHandlers) {
+    .load = window_load,
+    .appear = window_appear,
+    .disappear = window_disappear,
+    .unload = window_unload
+  });
+}
+
+void chart_deinit() {
+  window_destroy(window);
+}
\ No newline at end of file
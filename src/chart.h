@@ -0,0 +1,6 @@
+#pragma once
+
+void show_chart();
+
+void chart_init();
+void chart_deinit();
\ No newline at end of file
@@ -8,6 +8,7 @@ typedef enum {
   EditStartTimeRow,
   EditIntervalRow,
   DeleteRow,
+  UndoEditRow,
   RowCount
 } Row;
 
@@ -18,13 +19,26 @@ static MenuLayer *menu_layer;
 
 static uint32_t key;
 
+// The record as it was before the edit just saved, which undo brings back
+static bool showing_undo_edit;
+static uint32_t key_before_edit;
+
+// What the menu last showed, so returning to it only reloads after an edit
+static uint32_t rendered_key;
+static uint32_t rendered_data_version;
+
+// Static functions
+static bool undo_edit_is_available() {
+  return showing_undo_edit && store_can_undo();
+}
+
 // Menu layer callbacks
 static uint16_t menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
   return 1;
 }
 
 static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  return RowCount;
+  return undo_edit_is_available() ? RowCount : UndoEditRow;
 }
 
 static int16_t menu_get_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
@@ -65,6 +79,10 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
       menu_cell_basic_draw(ctx, cell_layer, "Delete", NULL, trash_icon);
       break;
 
+    case UndoEditRow:
+      menu_cell_basic_draw(ctx, cell_layer, "Undo Edit", NULL, NULL);
+      break;
+
     default:
       break;
   }
@@ -84,6 +102,14 @@ static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, v
       show_delete_contraction(key, false);
       break;
 
+    case UndoEditRow:
+      if (store_undo_last_transaction()) {
+        key = key_before_edit;
+      }
+      showing_undo_edit = false;
+      menu_layer_reload_data(menu_layer);
+      break;
+
     default:
       break;
   }
@@ -111,6 +137,12 @@ static void window_load() {
 }
 
 static void window_appear() {
+  if (rendered_key == key && rendered_data_version == store_data_version()) {
+    return;
+  }
+
+  rendered_key = key;
+  rendered_data_version = store_data_version();
   menu_layer_reload_data(menu_layer);
 }
 
@@ -121,11 +153,14 @@ static void window_unload() {
 // Non-static functions
 void show_contraction_menu(uint32_t contraction_key) {
   key = contraction_key;
+  showing_undo_edit = false;
   window_stack_push(window, true);
 }
 
 void pop_to_contraction_menu(uint32_t contraction_key) {
+  key_before_edit = key;
   key = contraction_key;
+  showing_undo_edit = true;
   window_stack_pop(true);
 }
 
@@ -1,12 +1,18 @@
 #include <pebble.h>
 #include "store.h"
+#include "calendar.h"
 #include "contraction_menu.h"
 #include "edit_contraction.h"
 #include "delete_contraction.h"
 
-#define LONG_CLICK_DELAY 1000
+#define REPEAT_CLICK_INTERVAL 100
 #define SMALL_DELTA_IN_SECONDS 1
+#define MEDIUM_DELTA_IN_SECONDS 10
 #define BIG_DELTA_IN_SECONDS 60
+// A held button steps by 1 s for its first second, 10 s for the next and
+// 60 s after that
+#define REPEATS_PER_STEP_SIZE 10
+#define FRAME_DURATION 33
 
 typedef enum {
   EditingState,
@@ -55,6 +61,9 @@ static char error_message_min_interval_text[] = "Cannot be negative.";
 static TextLayer *up_button_text_layer;
 static TextLayer *down_button_text_layer;
 
+// Pending redraw; a burst of repeated clicks redraws at most once a frame
+static AppTimer *frame_timer;
+
 // Static functions
 static bool data_is_modified() {
   return (mode == EditStartTime && current_contraction.start_time != modified_contraction.start_time) || 
@@ -111,12 +120,7 @@ static void update_ui() {
   }
 
   if (mode == EditStartTime) {
-    struct tm *date_time = localtime(&modified_contraction.start_time);
-    int hour = date_time->tm_hour;
-    int minute = date_time->tm_min;
-    int second = date_time->tm_sec;
-
-    store_time_for_time(big_text, sizeof(big_text), hour, minute, second);
+    store_time_for_seconds_into_day(big_text, sizeof(big_text), calendar_seconds_into_day(modified_contraction.start_time));
 
     // store_duration_for_seconds_elapsed(small_text, sizeof(small_text), modified_contraction.seconds_elapsed);
     int delta = modified_contraction.start_time - current_contraction.start_time;
@@ -141,13 +145,7 @@ static void update_ui() {
     int seconds = modified_contraction.seconds_elapsed;
     int minutes = seconds / 60;
 
-    modified_contraction.start_time += modified_contraction.seconds_elapsed;
-    struct tm *date_time = localtime(&modified_contraction.start_time);
-    modified_contraction.start_time -= modified_contraction.seconds_elapsed;
-
-    int hour = date_time->tm_hour;
-    int minute = date_time->tm_min;
-    int second = date_time->tm_sec;
+    time_t end_time = modified_contraction.start_time + modified_contraction.seconds_elapsed;
 
     if (minutes == 0) {
       snprintf(big_text, sizeof(big_text), "%d sec", seconds);
@@ -155,7 +153,7 @@ static void update_ui() {
       snprintf(big_text, sizeof(big_text), "%d min %d sec", minutes % 60, seconds % 60);
     }
     char end_time_text[16];
-    store_time_for_time(end_time_text, sizeof(end_time_text), hour, minute, second);
+    store_time_for_seconds_into_day(end_time_text, sizeof(end_time_text), calendar_seconds_into_day(end_time));
     snprintf(small_text, sizeof(small_text), "Stops %s", end_time_text);
 
     text_layer_set_text(title_text_layer, title_duration_text);
@@ -228,6 +226,47 @@ static void update_contraction_seconds_elapsed(int delta) {
   }
 }
 
+static void frame_timer_callback(void *data) {
+  frame_timer = NULL;
+  update_ui();
+}
+
+static void schedule_update_ui() {
+  if (frame_timer == NULL) {
+    frame_timer = app_timer_register(FRAME_DURATION, frame_timer_callback, NULL);
+  }
+}
+
+static void cancel_update_ui() {
+  if (frame_timer != NULL) {
+    app_timer_cancel(frame_timer);
+    frame_timer = NULL;
+  }
+}
+
+static int delta_for_click(ClickRecognizerRef recognizer) {
+  if (!click_recognizer_is_repeating(recognizer)) {
+    return SMALL_DELTA_IN_SECONDS;
+  }
+
+  int repeats = click_number_of_clicks_counted(recognizer);
+  if (repeats <= REPEATS_PER_STEP_SIZE) {
+    return SMALL_DELTA_IN_SECONDS;
+  } else if (repeats <= REPEATS_PER_STEP_SIZE * 2) {
+    return MEDIUM_DELTA_IN_SECONDS;
+  }
+  return BIG_DELTA_IN_SECONDS;
+}
+
+static void update_contraction(int delta) {
+  if (mode == EditStartTime) {
+    update_contraction_start_time(delta);
+  } else if (mode == EditInterval) {
+    update_contraction_seconds_elapsed(delta);
+  }
+  schedule_update_ui();
+}
+
 // Click handlers
 static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
   switch(screen_state) {
@@ -256,53 +295,47 @@ static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
   switch (screen_state) {
     case EditingState:
       // Increment
-      if (mode == EditStartTime) {
-        update_contraction_start_time(SMALL_DELTA_IN_SECONDS);
-      } else if (mode == EditInterval) {
-        update_contraction_seconds_elapsed(SMALL_DELTA_IN_SECONDS);
-      }
-      break;
+      update_contraction(delta_for_click(recognizer));
+      return;
 
     case SavingState:
-      // Confirm save
-      pop_to_contraction_menu(store_replace_contraction(current_contraction_key, modified_contraction.start_time, modified_contraction.seconds_elapsed));
+      // Holding the button must not save more than once
+      if (click_recognizer_is_repeating(recognizer)) {
+        return;
+      }
+      // Confirm save, as one transaction the contraction menu can undo
+      store_begin_transaction();
+      uint32_t saved_contraction_key = store_replace_contraction(current_contraction_key, modified_contraction.start_time, modified_contraction.seconds_elapsed);
+      store_commit_transaction();
+      pop_to_contraction_menu(saved_contraction_key);
       break;
   }
 
   update_ui();
 }
 
-static void up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (screen_state == EditingState) {
-    // Big increment
-    if (mode == EditStartTime) {
-      update_contraction_start_time(BIG_DELTA_IN_SECONDS);
-    } else if (mode == EditInterval) {
-      update_contraction_seconds_elapsed(BIG_DELTA_IN_SECONDS);
-    }
-  }
-  update_ui();
-}
-
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
   if (screen_state == EditingState && !showing_discard_changes) {
     if (data_is_modified()) {
       screen_state = SavingState;
     }
   }
+  cancel_update_ui();
   update_ui();
 }
 
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
   if (screen_state == EditingState) {
     // Decrement
-    if (mode == EditStartTime) {
-      update_contraction_start_time(-SMALL_DELTA_IN_SECONDS);
-    } else if (mode == EditInterval) {
-      update_contraction_seconds_elapsed(-SMALL_DELTA_IN_SECONDS);
-    }
+    update_contraction(-delta_for_click(recognizer));
+    return;
+  }
 
-  } else if (screen_state == SavingState) {
+  if (click_recognizer_is_repeating(recognizer)) {
+    return;
+  }
+
+  if (screen_state == SavingState) {
     if (showing_discard_changes) {
       window_stack_pop(true);
 
@@ -315,28 +348,14 @@ static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
   update_ui();
 }
 
-static void down_long_click_handler(ClickRecognizerRef recognizer, void *context) {
-  if (screen_state == EditingState) {
-    // Big decrement
-    if (mode == EditStartTime) {
-      update_contraction_start_time(-BIG_DELTA_IN_SECONDS);
-    } else if (mode == EditInterval) {
-      update_contraction_seconds_elapsed(-BIG_DELTA_IN_SECONDS);
-    }
-  }
-  update_ui();
-}
-
 static void click_config_provider(void *context) {
   window_single_click_subscribe(BUTTON_ID_BACK, (ClickHandler)back_click_handler);
 
-  window_single_click_subscribe(BUTTON_ID_UP, (ClickHandler)up_click_handler);
-  window_long_click_subscribe(BUTTON_ID_UP, LONG_CLICK_DELAY, (ClickHandler)up_long_click_handler, NULL);
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, REPEAT_CLICK_INTERVAL, (ClickHandler)up_click_handler);
 
   window_single_click_subscribe(BUTTON_ID_SELECT, (ClickHandler)select_click_handler);
 
-  window_single_click_subscribe(BUTTON_ID_DOWN, (ClickHandler)down_click_handler);
-  window_long_click_subscribe(BUTTON_ID_DOWN, LONG_CLICK_DELAY, (ClickHandler)down_long_click_handler, NULL);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, REPEAT_CLICK_INTERVAL, (ClickHandler)down_click_handler);
 }
 
 // Window callbacks
@@ -403,6 +422,10 @@ static void window_appear(Window *window) {
   update_ui();
 }
 
+static void window_disappear(Window *window) {
+  cancel_update_ui();
+}
+
 static void window_unload(Window *window) {
   text_layer_destroy(title_text_layer);
   text_layer_destroy(big_text_layer);
@@ -454,6 +477,7 @@ void edit_contraction_init() {
   window_set_window_handlers(window, (WindowHandlers){
     .load = window_load,
     .appear = window_appear,
+    .disappear = window_disappear,
     .unload = window_unload,
   });
 }
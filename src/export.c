@@ -0,0 +1,408 @@
+#include "export.h"
+#include "log_format.h"
+#include "store.h"
+
+// Records are packed as described in log_format.h; a change is its kind
+// (1 byte) followed by the record
+#define RECORD_SIZE LOG_RECORD_SIZE
+#define CHANGE_SIZE (1 + RECORD_SIZE)
+#define CHUNK_BUFFER_SIZE 576
+#define EXPORT_INBOX_SIZE 256
+#define MAX_NUMBER_OF_RETRIES 6
+#define RETRY_DELAY 500
+
+// Message keys, as listed under appKeys in appinfo.json
+typedef enum {
+  ExportCountKey = 0,
+  ExportOffsetKey = 1,
+  ExportRecordsKey = 2,
+  ExportDoneKey = 3,
+  ExportRequestKey = 4,
+  SyncRequestKey = 5,
+  SyncChangesKey = 6,
+  SyncSequenceKey = 7,
+  SyncAckKey = 8,
+  ImportBeginKey = 9,
+  ImportRecordsKey = 10,
+  ImportDoneKey = 11,
+  ImportReadyKey = 12,
+  ExportArchiveCutoffKey = 13
+} ExportKey;
+
+typedef enum {
+  NoTransfer,
+  FullTransfer,
+  ChangesTransfer
+} Transfer;
+
+static Transfer transfer;
+static int records_per_chunk;
+static int changes_per_chunk;
+static bool last_chunk_in_flight;
+static int number_of_retries;
+static AppTimer *retry_timer;
+// Set while a transfer waits for the phone to come back; it then carries on
+// from the chunk that did not get through
+static bool waiting_for_connection;
+static uint8_t chunk_buffer[CHUNK_BUFFER_SIZE];
+
+// Full transfer
+static int next_offset;
+static int number_of_records_in_flight;
+static uint32_t exported_data_version;
+static uint32_t exported_sequence;
+
+// Changes transfer; 0 until the phone has said where it is
+static uint32_t phone_sequence;
+static uint32_t sent_sequence;
+static uint32_t sequence_in_flight;
+
+// Restore from the phone
+static bool importing;
+
+// Static functions
+static int pack_records(int first_index, int count) {
+  uint8_t *bytes = chunk_buffer;
+  for (int i = 0; i < count; i++) {
+    Contraction contraction;
+    store_contraction_at_index(first_index + i, &contraction);
+    bytes = log_pack_record(bytes, contraction.start_time, contraction.seconds_elapsed);
+  }
+  return bytes - chunk_buffer;
+}
+
+// Packs the changes after sent_sequence that fit and reports whether they
+// were the last ones
+static int pack_changes(bool *is_last) {
+  uint8_t *bytes = chunk_buffer;
+  uint32_t sequence = sent_sequence;
+  Change change;
+
+  *is_last = true;
+  while (store_next_change(sequence, &change)) {
+    if ((bytes - chunk_buffer) / CHANGE_SIZE == changes_per_chunk) {
+      *is_last = false;
+      break;
+    }
+
+    bytes[0] = change.kind;
+    bytes = log_pack_record(bytes + 1, change.start_time, change.seconds_elapsed);
+    sequence = change.sequence;
+  }
+
+  sequence_in_flight = sequence;
+  return bytes - chunk_buffer;
+}
+
+static void import_records(const uint8_t *bytes, int length) {
+  for (int i = 0; i + RECORD_SIZE <= length; i += RECORD_SIZE) {
+    uint32_t start_time;
+    uint16_t seconds_elapsed;
+    log_unpack_record(&bytes[i], &start_time, &seconds_elapsed);
+    store_import_contraction(start_time, seconds_elapsed);
+  }
+}
+
+// Tells the phone whether its records can come now. It asks again when no
+// answer comes, so one that does not fit the outbox is left for then.
+static void send_import_ready(bool ready) {
+  // The outbox belongs to a running transfer, whose acks it would confuse
+  if (transfer != NoTransfer) {
+    return;
+  }
+
+  DictionaryIterator *iterator;
+  if (app_message_outbox_begin(&iterator) != APP_MSG_OK) {
+    return;
+  }
+  dict_write_uint8(iterator, ImportReadyKey, ready ? 1 : 0);
+  dict_write_end(iterator);
+  app_message_outbox_send();
+}
+
+static void send_next_chunk();
+static void start_transfer(Transfer kind);
+
+static void retry_timer_callback(void *data) {
+  retry_timer = NULL;
+  send_next_chunk();
+}
+
+// Back off exponentially, and leave the radio alone once the phone is gone
+// or has stopped answering
+static void retry_later() {
+  if (!connection_service_peek_pebble_app_connection() || number_of_retries >= MAX_NUMBER_OF_RETRIES) {
+    waiting_for_connection = true;
+    return;
+  }
+
+  retry_timer = app_timer_register(RETRY_DELAY << number_of_retries, retry_timer_callback, NULL);
+  number_of_retries++;
+}
+
+static void resume_transfer() {
+  waiting_for_connection = false;
+  number_of_retries = 0;
+  if (retry_timer == NULL) {
+    send_next_chunk();
+  }
+}
+
+static void write_full_chunk(DictionaryIterator *iterator) {
+  // An edit in the middle of an export would mix two versions of the log
+  if (exported_data_version != store_data_version()) {
+    exported_data_version = store_data_version();
+    exported_sequence = store_sync_sequence();
+    next_offset = 0;
+  }
+
+  int total = store_number_of_past_contractions();
+  int count = total - next_offset;
+  if (count > records_per_chunk) {
+    count = records_per_chunk;
+  }
+
+  dict_write_uint32(iterator, ExportCountKey, total);
+  dict_write_uint32(iterator, ExportOffsetKey, next_offset);
+  if (count > 0) {
+    dict_write_data(iterator, ExportRecordsKey, chunk_buffer, pack_records(next_offset, count));
+  }
+
+  number_of_records_in_flight = count;
+  last_chunk_in_flight = next_offset + count >= total;
+  if (last_chunk_in_flight) {
+    dict_write_uint8(iterator, ExportDoneKey, 1);
+    dict_write_uint32(iterator, SyncSequenceKey, exported_sequence);
+    // The phone keeps its own copies of the records archived up to here
+    dict_write_uint32(iterator, ExportArchiveCutoffKey, store_archive_cutoff());
+  }
+}
+
+static void write_changes_chunk(DictionaryIterator *iterator) {
+  bool is_last;
+  int size = pack_changes(&is_last);
+  if (size > 0) {
+    dict_write_data(iterator, SyncChangesKey, chunk_buffer, size);
+  }
+
+  last_chunk_in_flight = is_last;
+  if (is_last) {
+    dict_write_uint32(iterator, SyncSequenceKey, store_sync_sequence());
+  }
+}
+
+static void send_next_chunk() {
+  if (transfer == NoTransfer || waiting_for_connection) {
+    return;
+  }
+  if (!connection_service_peek_pebble_app_connection()) {
+    waiting_for_connection = true;
+    return;
+  }
+  if (transfer == ChangesTransfer && !store_can_sync_from(sent_sequence)) {
+    // Changes the phone has not had were dropped from the log meanwhile
+    start_transfer(FullTransfer);
+    return;
+  }
+
+  DictionaryIterator *iterator;
+  if (app_message_outbox_begin(&iterator) != APP_MSG_OK) {
+    retry_later();
+    return;
+  }
+
+  if (transfer == FullTransfer) {
+    write_full_chunk(iterator);
+  } else {
+    write_changes_chunk(iterator);
+  }
+  dict_write_end(iterator);
+
+  if (app_message_outbox_send() != APP_MSG_OK) {
+    retry_later();
+  }
+}
+
+static void start_transfer(Transfer kind) {
+  transfer = kind;
+  number_of_retries = 0;
+  waiting_for_connection = false;
+
+  next_offset = 0;
+  exported_data_version = store_data_version();
+  exported_sequence = store_sync_sequence();
+  sent_sequence = phone_sequence;
+
+  send_next_chunk();
+}
+
+// Catch the phone up from the change log when it can, otherwise resend
+// everything
+static void sync_phone() {
+  if (transfer != NoTransfer) {
+    // A stalled transfer picks up whatever changed since it stopped
+    if (waiting_for_connection && connection_service_peek_pebble_app_connection()) {
+      resume_transfer();
+    }
+    return;
+  }
+
+  if (store_can_sync_from(phone_sequence)) {
+    start_transfer(ChangesTransfer);
+  } else {
+    start_transfer(FullTransfer);
+  }
+}
+
+// Store callbacks
+static void store_changed_handler(uint32_t data_version) {
+  // Push new changes to a phone that is known to be listening
+  if (phone_sequence > 0) {
+    sync_phone();
+  }
+}
+
+// Connection callbacks
+static void connection_handler(bool connected) {
+  if (!connected) {
+    if (retry_timer != NULL) {
+      app_timer_cancel(retry_timer);
+      retry_timer = NULL;
+    }
+    if (transfer != NoTransfer) {
+      waiting_for_connection = true;
+    }
+    return;
+  }
+
+  if (transfer != NoTransfer) {
+    resume_transfer();
+    return;
+  }
+
+  // Send what piled up while the phone was away
+  Change change;
+  if (phone_sequence > 0 && (!store_can_sync_from(phone_sequence) || store_next_change(phone_sequence, &change))) {
+    sync_phone();
+  }
+}
+
+// AppMessage callbacks
+static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
+  if (transfer == NoTransfer) {
+    return;
+  }
+
+  // The phone's ack is the signal to send the next chunk
+  number_of_retries = 0;
+
+  if (transfer == FullTransfer) {
+    if (last_chunk_in_flight && exported_data_version == store_data_version()) {
+      transfer = NoTransfer;
+      return;
+    }
+    next_offset += number_of_records_in_flight;
+  } else {
+    sent_sequence = sequence_in_flight;
+    if (last_chunk_in_flight && sent_sequence == store_sync_sequence()) {
+      transfer = NoTransfer;
+      return;
+    }
+  }
+
+  send_next_chunk();
+}
+
+static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
+  if (transfer != NoTransfer) {
+    retry_later();
+  }
+}
+
+static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
+  if (dict_find(iterator, ImportBeginKey) != NULL) {
+    // Refused while a migration is loading the records; the phone retries
+    importing = store_begin_import();
+    send_import_ready(importing);
+  }
+
+  Tuple *tuple = dict_find(iterator, ImportRecordsKey);
+  if (tuple != NULL && importing) {
+    import_records(tuple->value->data, tuple->length);
+  }
+
+  if (dict_find(iterator, ImportDoneKey) != NULL && importing) {
+    importing = false;
+    store_end_import();
+  }
+
+  tuple = dict_find(iterator, SyncAckKey);
+  if (tuple != NULL) {
+    // The phone has stored everything up to here
+    phone_sequence = tuple->value->uint32;
+    store_acknowledge_changes(phone_sequence);
+  }
+
+  tuple = dict_find(iterator, SyncRequestKey);
+  if (tuple != NULL) {
+    phone_sequence = tuple->value->uint32;
+    store_acknowledge_changes(phone_sequence);
+    sync_phone();
+  }
+
+  if (dict_find(iterator, ExportRequestKey) != NULL) {
+    export_start();
+  }
+}
+
+// Non-static functions
+void export_start() {
+  if (transfer == NoTransfer) {
+    start_transfer(FullTransfer);
+  } else if (waiting_for_connection) {
+    resume_transfer();
+  }
+}
+
+void export_init() {
+  app_message_register_inbox_received(inbox_received_callback);
+  app_message_register_outbox_sent(outbox_sent_callback);
+  app_message_register_outbox_failed(outbox_failed_callback);
+  connection_service_subscribe((ConnectionHandlers) {
+    .pebble_app_connection_handler = connection_handler
+  });
+
+  uint32_t outbox_size = app_message_outbox_size_maximum();
+  app_message_open(EXPORT_INBOX_SIZE, outbox_size);
+
+  // Fill the outbox: whatever the other tuples leave over carries records
+  uint32_t header_size = dict_calc_buffer_size(6, sizeof(uint32_t), sizeof(uint32_t), 0, sizeof(uint8_t), sizeof(uint32_t), sizeof(uint32_t));
+  uint32_t payload_size = outbox_size > header_size ? outbox_size - header_size : 0;
+  if (payload_size > CHUNK_BUFFER_SIZE) {
+    payload_size = CHUNK_BUFFER_SIZE;
+  }
+
+  records_per_chunk = payload_size / RECORD_SIZE > 0 ? payload_size / RECORD_SIZE : 1;
+  changes_per_chunk = payload_size / CHANGE_SIZE > 0 ? payload_size / CHANGE_SIZE : 1;
+
+  store_subscribe(store_changed_handler);
+}
+
+void export_deinit() {
+  if (retry_timer != NULL) {
+    app_timer_cancel(retry_timer);
+    retry_timer = NULL;
+  }
+  transfer = NoTransfer;
+  waiting_for_connection = false;
+  connection_service_unsubscribe();
+
+  // Keep whatever arrived before the phone went quiet
+  if (importing) {
+    importing = false;
+    store_end_import();
+  }
+
+  store_unsubscribe(store_changed_handler);
+  app_message_deregister_callbacks();
+}
\ No newline at end of file
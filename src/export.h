@@ -0,0 +1,7 @@
+#include <pebble.h>
+#pragma once
+
+void export_start();
+
+void export_init();
+void export_deinit();
\ No newline at end of file
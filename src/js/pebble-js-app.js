@@ -0,0 +1,258 @@
+// Keeps a copy of the contraction log from the watch in localStorage. The
+// first sync receives the whole log in chunks; later ones only receive the
+// changes made since the last sequence the phone acknowledged. A watch whose
+// sequence went backwards was reset, so it gets the phone's copy back first.
+
+// Must match log_format.h and the change kinds in store.h
+var RECORD_SIZE = 6;
+var CHANGE_SIZE = 1 + RECORD_SIZE;
+var CHANGE_PUT = 0;
+var CHANGE_REMOVE = 1;
+var CHANGE_REMOVE_ALL = 2;
+
+// Records per import message; must fit EXPORT_INBOX_SIZE in export.c
+var IMPORT_RECORDS_PER_CHUNK = 36;
+
+// A watch that has not answered a restore in time is asked again, and one
+// that refused it, while it converts its own log, a little later
+var IMPORT_READY_TIMEOUT = 5000;
+var IMPORT_RETRY_DELAY = 2000;
+var MAX_IMPORT_ATTEMPTS = 10;
+
+var STORAGE_KEY = 'contractions';
+var SEQUENCE_STORAGE_KEY = 'syncSequence';
+
+var receivedRecords = [];
+var expectedOffset = 0;
+
+// Records waiting for the watch to say it can take them
+var pendingRestore = null;
+var importAttempts = 0;
+var importTimer = null;
+
+function decodeRecord(bytes, i) {
+  return {
+    startTime: (bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16) | (bytes[i + 3] << 24)) >>> 0,
+    secondsElapsed: bytes[i + 4] | (bytes[i + 5] << 8)
+  };
+}
+
+function decodeRecords(bytes) {
+  var records = [];
+  for (var i = 0; i + RECORD_SIZE <= bytes.length; i += RECORD_SIZE) {
+    records.push(decodeRecord(bytes, i));
+  }
+  return records;
+}
+
+function encodeRecords(records) {
+  var bytes = [];
+  records.forEach(function(record) {
+    var startTime = record.startTime;
+    var secondsElapsed = Math.min(record.secondsElapsed, 0xffff);
+    bytes.push(startTime & 0xff, (startTime >>> 8) & 0xff, (startTime >>> 16) & 0xff, (startTime >>> 24) & 0xff);
+    bytes.push(secondsElapsed & 0xff, (secondsElapsed >>> 8) & 0xff);
+  });
+  return bytes;
+}
+
+function loadRecords() {
+  return JSON.parse(localStorage.getItem(STORAGE_KEY) || '[]');
+}
+
+function saveRecords(records, sequence) {
+  records.sort(function(a, b) {
+    return b.startTime - a.startTime;
+  });
+  localStorage.setItem(STORAGE_KEY, JSON.stringify(records));
+  localStorage.setItem(SEQUENCE_STORAGE_KEY, String(sequence));
+}
+
+function loadSequence() {
+  return parseInt(localStorage.getItem(SEQUENCE_STORAGE_KEY), 10) || 0;
+}
+
+function acknowledge(sequence) {
+  Pebble.sendAppMessage({ 'SyncAck': sequence }, null, function() {
+    console.log('Acknowledgement of ' + sequence + ' was not delivered');
+  });
+}
+
+function requestSync() {
+  var sequence = loadSequence();
+  Pebble.sendAppMessage({ 'SyncRequest': sequence }, null, function() {
+    console.log('Sync request was not delivered');
+  });
+}
+
+function askToImport() {
+  if (importAttempts === MAX_IMPORT_ATTEMPTS) {
+    console.log('Watch did not take the restore of ' + pendingRestore.length + ' contractions');
+    pendingRestore = null;
+    return;
+  }
+
+  importAttempts++;
+  importTimer = setTimeout(askToImport, IMPORT_READY_TIMEOUT);
+  Pebble.sendAppMessage({ 'ImportBegin': 1 }, null, function() {
+    console.log('Restore request was not delivered');
+  });
+}
+
+// The records go once the watch has answered ImportReady
+function restoreRecords(records) {
+  clearTimeout(importTimer);
+  pendingRestore = records;
+  importAttempts = 0;
+  askToImport();
+}
+
+function handleImportReady(ready) {
+  if (pendingRestore === null) {
+    return;
+  }
+
+  clearTimeout(importTimer);
+  if (!ready) {
+    importTimer = setTimeout(askToImport, IMPORT_RETRY_DELAY);
+    return;
+  }
+
+  var records = pendingRestore;
+  pendingRestore = null;
+  sendRecords(records);
+}
+
+// Sends the records newest first, which the watch appends without moving
+// the ones it has. The watch then sends the merged log on its own, as it
+// does after any change once the phone has asked for a sync.
+function sendRecords(records) {
+  var messages = [];
+  for (var i = 0; i < records.length; i += IMPORT_RECORDS_PER_CHUNK) {
+    messages.push({ 'ImportRecords': encodeRecords(records.slice(i, i + IMPORT_RECORDS_PER_CHUNK)) });
+  }
+  messages.push({ 'ImportDone': 1 });
+
+  // Whatever comes back next is the merged log, not a reset watch
+  localStorage.setItem(SEQUENCE_STORAGE_KEY, '0');
+
+  function sendNext(index) {
+    if (index === messages.length) {
+      console.log('Restored ' + records.length + ' contractions');
+      return;
+    }
+    Pebble.sendAppMessage(messages[index], function() {
+      sendNext(index + 1);
+    }, function() {
+      console.log('Restore stopped after ' + index + ' of ' + messages.length + ' messages');
+    });
+  }
+  sendNext(0);
+}
+
+// A full export holds every record the watch still keeps one by one. Those
+// up to the archive cutoff were rolled up into daily totals on the watch, so
+// the phone keeps its own copies of them; any other record it has was
+// deleted on the watch.
+function mergeExport(records, archiveCutoff) {
+  var archived = loadRecords().filter(function(record) {
+    return record.startTime <= archiveCutoff;
+  });
+  return records.concat(archived);
+}
+
+function handleExportChunk(payload) {
+  var offset = payload.ExportOffset;
+
+  // The watch starts over from offset 0 whenever the log changes mid-export
+  if (offset === 0) {
+    receivedRecords = [];
+    expectedOffset = 0;
+  }
+  if (offset !== expectedOffset) {
+    console.log('Unexpected chunk at ' + offset + ', expected ' + expectedOffset);
+    return;
+  }
+
+  var records = payload.ExportRecords ? decodeRecords(payload.ExportRecords) : [];
+  receivedRecords = receivedRecords.concat(records);
+  expectedOffset += records.length;
+
+  if (payload.ExportDone) {
+    if (receivedRecords.length === payload.ExportCount && (payload.SyncSequence || 0) < loadSequence()) {
+      var onWatch = {};
+      receivedRecords.forEach(function(record) {
+        onWatch[record.startTime] = true;
+      });
+      var missing = loadRecords().filter(function(record) {
+        return !onWatch[record.startTime];
+      });
+      if (missing.length > 0) {
+        restoreRecords(missing);
+        return;
+      }
+    }
+
+    if (receivedRecords.length === payload.ExportCount) {
+      saveRecords(mergeExport(receivedRecords, payload.ExportArchiveCutoff || 0), payload.SyncSequence || 0);
+      acknowledge(payload.SyncSequence || 0);
+      console.log('Exported ' + receivedRecords.length + ' contractions');
+    } else {
+      console.log('Export ended with ' + receivedRecords.length + ' of ' + payload.ExportCount + ' contractions');
+    }
+  }
+}
+
+// Changes arrive oldest first and at most once per record, so applying them
+// in order is enough
+var pendingChanges = [];
+
+function handleChanges(payload) {
+  var bytes = payload.SyncChanges || [];
+  for (var i = 0; i + CHANGE_SIZE <= bytes.length; i += CHANGE_SIZE) {
+    var change = decodeRecord(bytes, i + 1);
+    change.kind = bytes[i];
+    pendingChanges.push(change);
+  }
+
+  if (payload.SyncSequence === undefined) {
+    return;
+  }
+
+  var byStartTime = {};
+  loadRecords().forEach(function(record) {
+    byStartTime[record.startTime] = record;
+  });
+
+  pendingChanges.forEach(function(change) {
+    if (change.kind === CHANGE_REMOVE_ALL) {
+      byStartTime = {};
+    } else if (change.kind === CHANGE_REMOVE) {
+      delete byStartTime[change.startTime];
+    } else if (change.kind === CHANGE_PUT) {
+      byStartTime[change.startTime] = { startTime: change.startTime, secondsElapsed: change.secondsElapsed };
+    }
+  });
+
+  var records = Object.keys(byStartTime).map(function(key) {
+    return byStartTime[key];
+  });
+  saveRecords(records, payload.SyncSequence);
+  acknowledge(payload.SyncSequence);
+  console.log('Applied ' + pendingChanges.length + ' changes up to ' + payload.SyncSequence);
+  pendingChanges = [];
+}
+
+Pebble.addEventListener('ready', function() {
+  requestSync();
+});
+
+Pebble.addEventListener('appmessage', function(e) {
+  if (e.payload.ImportReady !== undefined) {
+    handleImportReady(e.payload.ImportReady === 1);
+  } else if (e.payload.ExportOffset !== undefined) {
+    handleExportChunk(e.payload);
+  } else if (e.payload.SyncChanges !== undefined || e.payload.SyncSequence !== undefined) {
+    handleChanges(e.payload);
+  }
+});
\ No newline at end of file
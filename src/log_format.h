@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+
+// Exported contraction logs, shared by the watch and host tools. Everything
+// is little endian.
+//
+// A record on the wire (ExportRecords, ImportRecords, and after the kind
+// byte in SyncChanges) is LOG_RECORD_SIZE bytes:
+//   0  uint32  start time
+//   4  uint16  duration in seconds
+//
+// A log file is a header, a session table and the records as two columns,
+// newest first, with every section 4-byte aligned so a host can map the
+// file and scan the columns in place:
+//   0  char[4] magic, LOG_FILE_MAGIC
+//   4  uint16  version, LOG_FILE_VERSION
+//   6  uint16  header size
+//   8  uint32  number of records
+//  12  uint32  number of sessions
+//  16  uint32  sync sequence of the export
+//  20  uint32  offset of the session table
+//  24  uint32  offset of the start time column, uint32 each
+//  28  uint32  offset of the duration column, uint16 each
+//  32  uint32  file size
+//  36  uint32  reserved, 0
+// A session table entry is LOG_SESSION_SIZE bytes, newest session first:
+//   0  uint32  index of its newest record
+//   4  uint32  number of records
+//   8  uint32  start time of its oldest record
+//  12  uint32  end time of its newest record
+//  16  uint32  total duration in seconds
+//  20  uint32  total start-to-start interval in seconds
+
+#define LOG_RECORD_SIZE 6
+
+#define LOG_FILE_MAGIC "CTLG"
+#define LOG_FILE_VERSION 1
+#define LOG_FILE_HEADER_SIZE 40
+#define LOG_SESSION_SIZE 24
+
+#define LOG_HEADER_VERSION_OFFSET 4
+#define LOG_HEADER_SIZE_OFFSET 6
+#define LOG_HEADER_COUNT_OFFSET 8
+#define LOG_HEADER_SESSION_COUNT_OFFSET 12
+#define LOG_HEADER_SEQUENCE_OFFSET 16
+#define LOG_HEADER_SESSIONS_OFFSET 20
+#define LOG_HEADER_START_TIMES_OFFSET 24
+#define LOG_HEADER_DURATIONS_OFFSET 28
+#define LOG_HEADER_FILE_SIZE_OFFSET 32
+
+static inline uint16_t log_read_uint16(const uint8_t *bytes) {
+  return bytes[0] | bytes[1] << 8;
+}
+
+static inline uint32_t log_read_uint32(const uint8_t *bytes) {
+  return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static inline uint8_t *log_write_uint16(uint8_t *bytes, uint16_t value) {
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  return bytes + 2;
+}
+
+static inline uint8_t *log_write_uint32(uint8_t *bytes, uint32_t value) {
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  bytes[2] = value >> 16;
+  bytes[3] = value >> 24;
+  return bytes + 4;
+}
+
+static inline uint8_t *log_pack_record(uint8_t *bytes, uint32_t start_time, int seconds_elapsed) {
+  bytes = log_write_uint32(bytes, start_time);
+  return log_write_uint16(bytes, seconds_elapsed > UINT16_MAX ? UINT16_MAX : seconds_elapsed);
+}
+
+static inline void log_unpack_record(const uint8_t *bytes, uint32_t *start_time, uint16_t *seconds_elapsed) {
+  *start_time = log_read_uint32(bytes);
+  *seconds_elapsed = log_read_uint16(bytes + 4);
+}
\ No newline at end of file
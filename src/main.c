@@ -1,28 +1,60 @@
 #include <pebble.h>
+#include "calendar.h"
 #include "store.h"
 #include "disclaimer.h"
 #include "menu.h"
 #include "summary.h"
+#include "chart.h"
 #include "new_contraction.h"
 #include "past_contractions.h"
 #include "contraction_menu.h"
 #include "edit_contraction.h"
 #include "delete_contraction.h"
+#include "export.h"
+
+// Long enough for the timer's first frame to be drawn before the rest of
+// the app is set up
+#define DEFERRED_INIT_DELAY 50
 
 static bool should_show_disclaimer = false;
+static bool modules_initialized = false;
 
-static void init() {
+// Everything but the calendar and the timer screen
+static void init_modules() {
   store_init();
 
   disclaimer_init();
   menu_init();
   summary_init();
-  new_contraction_init();
+  chart_init();
   past_contractions_init();
   contraction_menu_init();
   edit_contraction_init();
   delete_contraction_init();
 
+  export_init();
+
+  modules_initialized = true;
+}
+
+static void deferred_init_callback(void *data) {
+  init_modules();
+}
+
+static void init() {
+  calendar_init();
+  new_contraction_init();
+
+  // Quick launch goes straight to the timer; the store and the other
+  // screens are set up once its first frame is out
+  if (launch_reason() == APP_LAUNCH_QUICK_LAUNCH && !store_should_show_disclaimer()) {
+    show_new_contraction_at_launch();
+    app_timer_register(DEFERRED_INIT_DELAY, deferred_init_callback, NULL);
+    return;
+  }
+
+  init_modules();
+
   if (store_should_show_disclaimer()) {
     show_disclaimer();
   } else {
@@ -31,7 +63,15 @@ static void init() {
 }
 
 static void deinit() {
+  new_contraction_deinit();
+
+  if (!modules_initialized) {
+    calendar_deinit();
+    return;
+  }
+
   store_deinit();
+  calendar_deinit();
 
   if (should_show_disclaimer) {
     disclaimer_deinit();
@@ -39,11 +79,13 @@ static void deinit() {
   
   menu_deinit();
   summary_deinit();
-  new_contraction_deinit();
+  chart_deinit();
   past_contractions_deinit();
   contraction_menu_deinit();
   edit_contraction_deinit();
   delete_contraction_deinit();
+
+  export_deinit();
 }
 
 int main(void) {
@@ -76,8 +76,8 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
           break;
 
         case PastContractionsRow: {
-          char subtitle_text[] = "XX/64 recorded";
-          snprintf(subtitle_text, sizeof(subtitle_text), "%d/64 recorded", store_number_of_past_contractions());
+          char subtitle_text[24];
+          snprintf(subtitle_text, sizeof(subtitle_text), "%d/%d recorded", store_number_of_past_contractions(), MAX_NUMBER_OF_CONTRACTIONS);
           menu_cell_basic_draw(ctx, cell_layer, "Past Contractions", subtitle_text, NULL);
         } break;
 
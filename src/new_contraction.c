@@ -1,6 +1,10 @@
 #include <pebble.h>
 #include "new_contraction.h"
+#include "menu.h"
 #include "store.h"
+#include "calendar.h"
+
+#define LIVE_SUMMARY_MINUTES 60
 
 typedef enum {
   TimerStarted,
@@ -8,9 +12,19 @@ typedef enum {
 } ScreenState;
 
 static ScreenState screenState;
+// Opened by quick launch, with nothing beneath it on the window stack
+static bool launched_directly;
 static struct tm *start_time;
 static int seconds_elapsed;
 
+// Snapshot of the summary window taken when the timer starts; each tick
+// folds the running contraction into it without touching the records. The
+// newest record is taken apart from it, as it may be older than the window.
+static time_t timer_start_time;
+static SummaryTotals live_totals;
+static bool has_last_contraction;
+static time_t last_start_time;
+
 static GBitmap *action_icon_play;
 static GBitmap *action_icon_stop;
 static GBitmap *action_icon_yes;
@@ -34,6 +48,37 @@ static TextLayer *down_button_text_layer;
 static TextLayer *stop_timer_first_layer;
 static char stop_timer_first_text[] = "TO EXIT, STOP THE TIMER FIRST.";
 
+static TextLayer *live_summary_layer;
+static char live_summary_text[48];
+
+static void update_live_summary() {
+  SummaryResult projected = store_project_summary(&live_totals, timer_start_time, seconds_elapsed);
+
+  char since_last_text[16] = "--:--";
+  if (has_last_contraction) {
+    int since_last = timer_start_time + seconds_elapsed - last_start_time;
+    if (since_last < 60 * 60) {
+      snprintf(since_last_text, sizeof(since_last_text), "%02d:%02d", since_last / 60, since_last % 60);
+    } else {
+      snprintf(since_last_text, sizeof(since_last_text), "%d:%02d:%02d", since_last / (60 * 60), since_last / 60 % 60, since_last % 60);
+    }
+  }
+
+  snprintf(live_summary_text, sizeof(live_summary_text), "SINCE LAST %s\nAVG %02d:%02d EVERY %02d:%02d",
+    since_last_text,
+    projected.average_duration_in_seconds / 60, projected.average_duration_in_seconds % 60,
+    projected.average_interval_in_seconds / 60, projected.average_interval_in_seconds % 60);
+  text_layer_set_text(live_summary_layer, live_summary_text);
+}
+
+static void take_live_snapshot() {
+  live_totals = store_calculate_summary_totals(LIVE_SUMMARY_MINUTES);
+
+  Contraction last_contraction;
+  has_last_contraction = store_contraction_at_index(0, &last_contraction);
+  last_start_time = has_last_contraction ? last_contraction.start_time : 0;
+}
+
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
   if (start_time == NULL) {
     start_time = tick_time;
@@ -46,20 +91,23 @@ static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
 
   snprintf(timer_text, sizeof(timer_text), "%02d:%02d", minutes_elapsed, seconds_remainder);
   text_layer_set_text(timer_layer, timer_text);
+
+  update_live_summary();
 }
 
 static void show_stop_timer_alert(bool show) {
   layer_set_hidden(text_layer_get_layer(stop_timer_first_layer), !show);
+  layer_set_hidden(text_layer_get_layer(live_summary_layer), show || screenState != TimerStarted);
 }
 
 static void stop_timer() {
-  tick_timer_service_unsubscribe();
+  calendar_unsubscribe_tick();
+  screenState = TimerStopped;
   show_stop_timer_alert(false);
   action_bar_layer_set_icon(action_bar_layer, BUTTON_ID_UP, action_icon_yes);
   action_bar_layer_set_icon(action_bar_layer, BUTTON_ID_DOWN, action_icon_no);
   text_layer_set_text(up_button_text_layer, save_text);
   text_layer_set_text(down_button_text_layer, discard_text);
-  screenState = TimerStopped;
 }
 
 static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -71,6 +119,11 @@ static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
   if (screenState == TimerStopped) {
     window_stack_pop(window);
+
+    if (launched_directly) {
+      launched_directly = false;
+      show_menu();
+    }
   }
 }
 
@@ -94,7 +147,7 @@ static void click_config_provider(void *context) {
 }
 
 static void start_timer() {
-  tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+  calendar_subscribe_tick(SECOND_UNIT, tick_handler);
 
   // Reset
   screenState = TimerStarted;
@@ -104,6 +157,11 @@ static void start_timer() {
   snprintf(timer_text, sizeof(timer_text), "00:00");
   text_layer_set_text(timer_layer, timer_text);
 
+  timer_start_time = time(NULL);
+  take_live_snapshot();
+  update_live_summary();
+  show_stop_timer_alert(false);
+
   text_layer_set_text(up_button_text_layer, start_text);
   text_layer_set_text(down_button_text_layer, NULL);
 
@@ -114,6 +172,15 @@ static void start_timer() {
   action_bar_layer_set_icon(action_bar_layer, BUTTON_ID_DOWN, NULL);
 }
 
+// Store callbacks
+static void store_changed_handler(uint32_t data_version) {
+  // Quick launch shows the timer before the store has loaded
+  if (screenState == TimerStarted) {
+    take_live_snapshot();
+    update_live_summary();
+  }
+}
+
 // Window callbacks
 static void window_load(Window *window) {
   action_bar_layer = action_bar_layer_create();
@@ -156,6 +223,14 @@ static void window_load(Window *window) {
   text_layer_set_text_alignment(stop_timer_first_layer, GTextAlignmentCenter);
   layer_add_child(window_layer, text_layer_get_layer(stop_timer_first_layer));
   layer_set_hidden(text_layer_get_layer(stop_timer_first_layer), true);
+
+  // Shares the alert's place below the timer and gives way to it
+  live_summary_layer = text_layer_create(GRect(0, timer_title_y + 18 + 34, width, 14 * 2 + 4));
+  text_layer_set_font(live_summary_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  text_layer_set_text_alignment(live_summary_layer, GTextAlignmentCenter);
+  layer_add_child(window_layer, text_layer_get_layer(live_summary_layer));
+
+  store_subscribe(store_changed_handler);
 }
 
 static void window_appear(Window *window) {
@@ -163,15 +238,18 @@ static void window_appear(Window *window) {
 }
 
 static void window_disappear(Window *window) {
-  tick_timer_service_unsubscribe();
+  calendar_unsubscribe_tick();
 }
 
 static void window_unload(Window *window) {
+  store_unsubscribe(store_changed_handler);
+
   text_layer_destroy(timer_title_layer);
   text_layer_destroy(timer_layer);
   text_layer_destroy(up_button_text_layer);
   text_layer_destroy(down_button_text_layer);
   text_layer_destroy(stop_timer_first_layer);
+  text_layer_destroy(live_summary_layer);
   action_bar_layer_destroy(action_bar_layer);
 }
 
@@ -179,6 +257,11 @@ void show_new_contraction() {
   window_stack_push(window, true);
 }
 
+void show_new_contraction_at_launch() {
+  launched_directly = true;
+  window_stack_push(window, false);
+}
+
 void new_contraction_init() {
   action_icon_play = gbitmap_create_with_resource(RESOURCE_ID_ACTION_ICON_PLAY);
   action_icon_stop = gbitmap_create_with_resource(RESOURCE_ID_ACTION_ICON_STOP);
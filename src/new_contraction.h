@@ -1,6 +1,7 @@
 #pragma once
 
 void show_new_contraction();
+void show_new_contraction_at_launch();
 
 void new_contraction_init();
 void new_contraction_deinit();
\ No newline at end of file
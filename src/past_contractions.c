@@ -2,20 +2,116 @@
 #include "past_contractions.h"
 #include "contraction_menu.h"
 #include "store.h"
+#include "calendar.h"
+
+typedef enum {
+  DateSectionKind,
+  SessionsSectionKind,
+  ExpandedSessionKind,
+  ArchivedSectionKind
+} SectionKind;
+
+// An expanded session (one menu section per date section), a run of
+// collapsed sessions (one menu section), or a resolved date section
+typedef struct {
+  uint8_t kind;
+  uint16_t first;
+  uint16_t length;
+} MenuSection;
 
 static Window *window;
 static MenuLayer *menu_layer;
 static TextLayer *empty_menu_layer;
 
 static int number_of_contractions;
+static int number_of_archived_days;
+
+// Bounded by the number of sessions, not by the number of days recorded
+static int number_of_session_entries;
+static MenuSection session_entries[MAX_NUMBER_OF_SESSIONS];
+static int number_of_menu_sections;
+static uint16_t expanded_sessions;
+
+// Store version the sections were last built from; 0 forces a rebuild
+static uint32_t rendered_data_version;
+
+// Static functions
+static bool session_is_expanded(int session) {
+  // The current session is always expanded
+  return session == 0 || (expanded_sessions & (1 << session));
+}
+
+static void rebuild_menu_sections() {
+  number_of_session_entries = 0;
+  number_of_menu_sections = 0;
+
+  for (int session = 0; session < store_number_of_sessions(); session++) {
+    MenuSection *last_entry = number_of_session_entries > 0 ? &session_entries[number_of_session_entries - 1] : NULL;
+
+    if (session_is_expanded(session)) {
+      int length = store_number_of_date_sections_for_session(session);
+      session_entries[number_of_session_entries++] = (MenuSection){
+        .kind = ExpandedSessionKind,
+        .first = session,
+        .length = length,
+      };
+      number_of_menu_sections += length;
+    } else if (last_entry != NULL && last_entry->kind == SessionsSectionKind) {
+      last_entry->length++;
+    } else {
+      session_entries[number_of_session_entries++] = (MenuSection){
+        .kind = SessionsSectionKind,
+        .first = session,
+        .length = 1,
+      };
+      number_of_menu_sections++;
+    }
+  }
+
+  // Archived days always come last, as one section
+  if (number_of_archived_days > 0) {
+    number_of_menu_sections++;
+  }
+}
+
+static MenuSection menu_section_for_index(int section_index) {
+  for (int i = 0; i < number_of_session_entries; i++) {
+    MenuSection entry = session_entries[i];
+
+    if (entry.kind == ExpandedSessionKind) {
+      if (section_index < entry.length) {
+        return (MenuSection){
+          .kind = DateSectionKind,
+          .first = store_first_date_section_for_session(entry.first) + section_index,
+          .length = 1,
+        };
+      }
+      section_index -= entry.length;
+    } else {
+      if (section_index == 0) {
+        return entry;
+      }
+      section_index--;
+    }
+  }
+
+  return (MenuSection){ .kind = ArchivedSectionKind, .first = 0, .length = number_of_archived_days };
+}
 
 // Menu layer callbacks
 static uint16_t menu_get_num_sections_callback(MenuLayer *menu_layer, void *data) {
-  return store_number_of_date_sections();
+  return number_of_menu_sections;
 }
 
 static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  return store_number_of_contractions_for_date_section(section_index);
+  MenuSection section = menu_section_for_index(section_index);
+  switch (section.kind) {
+    case DateSectionKind:
+      return store_number_of_contractions_for_date_section(section.first);
+
+    default:
+      return section.length;
+  }
 }
 
 static int16_t menu_get_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
@@ -23,24 +119,37 @@ static int16_t menu_get_header_height_callback(MenuLayer *menu_layer, uint16_t s
 }
 
 static void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
-  char header_text[32];
-  store_date_for_date_section(header_text, sizeof(header_text), section_index);
-  menu_cell_basic_header_draw(ctx, cell_layer, header_text);
+  MenuSection section = menu_section_for_index(section_index);
+  switch (section.kind) {
+    case DateSectionKind: {
+      char header_text[32];
+      store_date_for_date_section(header_text, sizeof(header_text), section.first);
+      menu_cell_basic_header_draw(ctx, cell_layer, header_text);
+    } break;
+
+    case ArchivedSectionKind:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Archived");
+      break;
+
+    default:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Earlier Sessions");
+      break;
+  }
 }
 
-static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+static void draw_contraction_row(GContext* ctx, const Layer *cell_layer, int date_section, int row) {
   Contraction contraction;
-  int status = store_contraction_for_date_section_index(cell_index->section, cell_index->row, &contraction);
+  int status = store_contraction_for_date_section_index(date_section, row, &contraction);
 
   char title_text[] = "00:00 XX";
   char subtitle_text[32];
 
   if (status == sizeof(Contraction)) {
-    struct tm *start_datetime = localtime(&contraction.start_time);
+    int seconds = calendar_seconds_into_day(contraction.start_time);
     int seconds_elapsed = contraction.seconds_elapsed;
 
-    int hour = start_datetime->tm_hour;
-    int minute = start_datetime->tm_min;
+    int hour = seconds / (60 * 60);
+    int minute = seconds / 60 % 60;
 
     store_time_for_hour_minute(title_text, sizeof(title_text), hour, minute);
     store_duration_for_seconds_elapsed(subtitle_text, sizeof(subtitle_text), seconds_elapsed);
@@ -49,9 +158,97 @@ static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuI
   menu_cell_basic_draw(ctx, cell_layer, title_text, subtitle_text, NULL);
 }
 
+static void draw_session_row(GContext* ctx, const Layer *cell_layer, int session_index) {
+  Session session;
+  char title_text[] = "Jan 01";
+  char subtitle_text[32];
+
+  if (store_session(session_index, &session)) {
+    int month;
+    int day;
+    calendar_month_day_for_time(session.start_time, &month, &day);
+    store_date_for_month_day(title_text, sizeof(title_text), month, day);
+    snprintf(subtitle_text, sizeof(subtitle_text), "%d contraction%s", session.count, session.count == 1 ? "" : "s");
+  }
+
+  menu_cell_basic_draw(ctx, cell_layer, title_text, subtitle_text, NULL);
+}
+
+static void draw_archived_day_row(GContext* ctx, const Layer *cell_layer, int archived_day) {
+  DailyAggregate aggregate;
+  char title_text[] = "Jan 01";
+  char subtitle_text[32];
+
+  if (store_archived_day(archived_day, &aggregate)) {
+    int month;
+    int day;
+    calendar_month_day_for_time(aggregate.start_time, &month, &day);
+    store_date_for_month_day(title_text, sizeof(title_text), month, day);
+
+    int average_duration = aggregate.total_duration_in_seconds / aggregate.count;
+    snprintf(subtitle_text, sizeof(subtitle_text), "%d, avg %d:%02d", aggregate.count, average_duration / 60, average_duration % 60);
+  }
+
+  menu_cell_basic_draw(ctx, cell_layer, title_text, subtitle_text, NULL);
+}
+
+static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  MenuSection section = menu_section_for_index(cell_index->section);
+  switch (section.kind) {
+    case DateSectionKind:
+      draw_contraction_row(ctx, cell_layer, section.first, cell_index->row);
+      break;
+
+    case ArchivedSectionKind:
+      draw_archived_day_row(ctx, cell_layer, cell_index->row);
+      break;
+
+    default:
+      draw_session_row(ctx, cell_layer, section.first + cell_index->row);
+      break;
+  }
+}
+
 static void menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
-  if (number_of_contractions > 0) {
-    show_contraction_menu(store_contraction_key(cell_index->section, cell_index->row));
+  if (number_of_contractions > 0 || number_of_archived_days > 0) {
+    MenuSection section = menu_section_for_index(cell_index->section);
+    switch (section.kind) {
+      case DateSectionKind:
+        show_contraction_menu(store_contraction_key(section.first, cell_index->row));
+        break;
+
+      case ArchivedSectionKind:
+        // Archived days are read-only
+        break;
+
+      default:
+        // Expand the session in place
+        expanded_sessions |= 1 << (section.first + cell_index->row);
+        rebuild_menu_sections();
+        menu_layer_reload_data(menu_layer);
+        break;
+    }
+  }
+}
+
+static void reload_menu() {
+  rendered_data_version = store_data_version();
+
+  number_of_contractions = store_number_of_past_contractions();
+  number_of_archived_days = store_number_of_archived_days();
+  if (number_of_contractions > 0 || number_of_archived_days > 0) {
+    rebuild_menu_sections();
+    menu_layer_reload_data(menu_layer);
+    layer_set_hidden(text_layer_get_layer(empty_menu_layer), true);
+  } else {
+    layer_set_hidden(text_layer_get_layer(empty_menu_layer), false);
+  }
+}
+
+// Store callbacks
+static void store_changed_handler(uint32_t data_version) {
+  if (window_stack_get_top_window() == window) {
+    reload_menu();
   }
 }
 
@@ -80,24 +277,26 @@ static void window_load(Window *window) {
   text_layer_set_text_alignment(empty_menu_layer, GTextAlignmentCenter);
   text_layer_set_font(empty_menu_layer, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
   layer_add_child(window_layer, text_layer_get_layer(empty_menu_layer));
+
+  store_subscribe(store_changed_handler);
 }
 
 static void window_appear(Window *window) {
-  number_of_contractions = store_number_of_past_contractions();
-  if (number_of_contractions > 0) {
-    menu_layer_reload_data(menu_layer);
-    layer_set_hidden(text_layer_get_layer(empty_menu_layer), true);
-  } else {
-    layer_set_hidden(text_layer_get_layer(empty_menu_layer), false);
+  if (rendered_data_version != store_data_version()) {
+    reload_menu();
   }
 }
 
 static void window_unload(Window *window) {
+  store_unsubscribe(store_changed_handler);
+
   menu_layer_destroy(menu_layer);
   text_layer_destroy(empty_menu_layer);
 }
 
 void show_past_contractions() {
+  expanded_sessions = 0;
+  rendered_data_version = 0;
   window_stack_push(window, true);
 }
 
@@ -0,0 +1,88 @@
+#include "storage.h"
+
+typedef struct RamValue {
+  struct RamValue *next;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[];
+} RamValue;
+
+static RamValue *ram_values;
+
+// Static functions
+static RamValue **ram_link_for_key(uint32_t key) {
+  RamValue **link = &ram_values;
+  while (*link != NULL && (*link)->key != key) {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+// RAM
+static bool ram_exists_handler(uint32_t key) {
+  return *ram_link_for_key(key) != NULL;
+}
+
+static int ram_read_handler(uint32_t key, void *buffer, size_t buffer_size) {
+  RamValue *value = *ram_link_for_key(key);
+  if (value == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  size_t size = value->size < buffer_size ? value->size : buffer_size;
+  memcpy(buffer, value->data, size);
+  return size;
+}
+
+// Same size limit as persist, so the store behaves the same on either
+static int ram_write_handler(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    size = PERSIST_DATA_MAX_LENGTH;
+  }
+
+  RamValue **link = ram_link_for_key(key);
+  RamValue *value = *link;
+  if (value == NULL || value->size != size) {
+    RamValue *resized_value = realloc(value, sizeof(RamValue) + size);
+    if (resized_value == NULL) {
+      return E_OUT_OF_MEMORY;
+    }
+    if (value == NULL) {
+      resized_value->next = NULL;
+      resized_value->key = key;
+    }
+    value = resized_value;
+    *link = value;
+  }
+
+  value->size = size;
+  memcpy(value->data, data, size);
+  return size;
+}
+
+static status_t ram_delete_handler(uint32_t key) {
+  RamValue **link = ram_link_for_key(key);
+  RamValue *value = *link;
+  if (value == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  *link = value->next;
+  free(value);
+  return S_SUCCESS;
+}
+
+// Non-static functions
+const StorageBackend storage_persist = {
+  .exists = persist_exists,
+  .read = persist_read_data,
+  .write = persist_write_data,
+  .delete = persist_delete,
+};
+
+const StorageBackend storage_ram = {
+  .exists = ram_exists_handler,
+  .read = ram_read_handler,
+  .write = ram_write_handler,
+  .delete = ram_delete_handler,
+};
\ No newline at end of file
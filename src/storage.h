@@ -0,0 +1,18 @@
+#include <pebble.h>
+#pragma once
+
+// Where the store keeps its values. Each call behaves like the persist_*
+// call of the same name: reads return the number of bytes read, writes the
+// number of bytes written, and both return a negative status on failure.
+typedef struct {
+  bool (*exists)(uint32_t key);
+  int (*read)(uint32_t key, void *buffer, size_t buffer_size);
+  int (*write)(uint32_t key, const void *data, size_t size);
+  status_t (*delete)(uint32_t key);
+} StorageBackend;
+
+// Pebble persist
+extern const StorageBackend storage_persist;
+
+// Values in the app heap, lost when the app exits
+extern const StorageBackend storage_ram;
\ No newline at end of file
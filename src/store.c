@@ -1,143 +1,1120 @@
 #include "store.h"
+#include "calendar.h"
 
+// Schema version 1 kept one key per record plus this index of record keys
 #define CONTRACTIONS_KEY 0
 #define DISCLAIMER_SHOWN_KEY 1
-#define MAX_NUMBER_OF_DATE_SECTIONS 32
-#define MAX_NUMBER_OF_CONTRACTIONS 64
+#define ARCHIVE_KEY 2
+#define SCHEMA_VERSION_KEY 3
+#define MIGRATION_PROGRESS_KEY 4
+#define RECORD_COUNT_KEY 5
+#define CHANGE_LOG_KEY 6
+// Schema version 2 packs records oldest first into consecutive pages
+#define RECORD_PAGE_KEY 16
+
+#define SCHEMA_VERSION 2
+#define MIGRATION_CHUNK_SIZE 8
+#define MIGRATION_CHUNK_DELAY 50
+
+// Version 1 had room for this many records, whatever the capacity now is
+#define VERSION_1_MAX_NUMBER_OF_CONTRACTIONS 64
+// Version 1 record keys were start times as decimal MMDDHHMMSS with a
+// zero-based month, so none is below that of January 1 at midnight
+#define VERSION_1_MIN_RECORD_KEY 1000000
+
+#define RECORDS_PER_PAGE (PERSIST_DATA_MAX_LENGTH / sizeof(Contraction))
+#define MAX_NUMBER_OF_ARCHIVED_DAYS (PERSIST_DATA_MAX_LENGTH / sizeof(DailyAggregate))
+#define ARCHIVE_AGE_IN_SECONDS (2 * 24 * 60 * 60)
+#define DATE_WINDOW_SIZE 8
+// Every screen that listens can be on the stack at once, and export listens too
+#define MAX_NUMBER_OF_SUBSCRIBERS 6
+#define UNDO_LOG_SIZE 16
+#define CHANGE_LOG_HEADER_SIZE (2 * sizeof(uint32_t))
+#define CHANGE_LOG_SIZE ((PERSIST_DATA_MAX_LENGTH - CHANGE_LOG_HEADER_SIZE) / sizeof(Change))
+
+// Persist space an app gets, and the part of the app heap the store's tables
+// may take out of the 24 KB the original Pebble gives an app
+#define PERSIST_STORAGE_BUDGET 4096
+#define STORE_RAM_BUDGET 4096
+#define NUMBER_OF_RECORD_PAGES ((MAX_NUMBER_OF_CONTRACTIONS + RECORDS_PER_PAGE - 1) / RECORDS_PER_PAGE)
+
+// The budgets are for the watch, where time_t and int are 32 bits, so they
+// are checked at the sizes records and tables have there. A host build,
+// with twice the bytes for each, then takes every capacity the watch does.
+#define WATCH_CONTRACTION_SIZE 8
+#define WATCH_DAILY_AGGREGATE_SIZE 24
+#define WATCH_UNDO_ENTRY_SIZE 12
+#define WATCH_SESSION_RANGE_SIZE 28
+#define WATCH_RECORDS_PER_PAGE (PERSIST_DATA_MAX_LENGTH / WATCH_CONTRACTION_SIZE)
+#define WATCH_NUMBER_OF_RECORD_PAGES ((MAX_NUMBER_OF_CONTRACTIONS + WATCH_RECORDS_PER_PAGE - 1) / WATCH_RECORDS_PER_PAGE)
+#define WATCH_ARCHIVE_SIZE (PERSIST_DATA_MAX_LENGTH / WATCH_DAILY_AGGREGATE_SIZE * WATCH_DAILY_AGGREGATE_SIZE)
 
 typedef struct {
-  uint8_t location;
-  uint8_t length;
+  uint16_t location;
+  uint16_t length;
   uint8_t month;
   uint8_t day;
-  char as_string[8];
+  uint8_t session;
 } DateRange;
 
-static int number_of_contractions;
-static uint32_t contraction_keys[MAX_NUMBER_OF_CONTRACTIONS];
+typedef struct {
+  uint16_t location;
+  uint16_t first_date_section;
+  uint16_t number_of_date_sections;
+  Session session;
+} SessionRange;
+
+typedef bool (*MigrationStep)();
+typedef void (*MigrationDiscard)();
+
+// Converts persisted data from one schema version to the next, a bounded
+// chunk per step. A step returns true once the conversion is complete.
+typedef struct {
+  int from_version;
+  MigrationStep step;
+  MigrationDiscard discard;
+} Migration;
+
+typedef enum {
+  UndoRemove,
+  UndoPut
+} UndoKind;
+
+// One step that reverses a change: remove the record with this start time,
+// or put this record back
+typedef struct {
+  uint8_t kind;
+  Contraction contraction;
+} UndoEntry;
 
+// Records sorted newest first, one column per field; a record's key is its
+// start time
+static int number_of_contractions;
+static uint32_t start_times[MAX_NUMBER_OF_CONTRACTIONS];
+static uint16_t durations[MAX_NUMBER_OF_CONTRACTIONS];
+static int last_found_index = -1;
+
+// Range of persisted positions (oldest first) not yet written to pages
+static int number_of_persisted_contractions;
+static int first_dirty_position = -1;
+static int last_dirty_position = -1;
+static Contraction page_buffer[RECORDS_PER_PAGE];
+
+static int schema_version;
+static int migration_progress;
+static AppTimer *migration_timer;
+
+// Only a window of date sections is decoded at a time; it is paged in
+// around whichever section the list asks for
 static int number_of_dates;
-static DateRange dates[MAX_NUMBER_OF_DATE_SECTIONS];
+static int date_window_start;
+static int date_window_length;
+static DateRange date_window[DATE_WINDOW_SIZE];
+
+static int number_of_sessions;
+static SessionRange sessions[MAX_NUMBER_OF_SESSIONS];
+
+// Changes staged in a transaction leave the sections stale rather than
+// rebuilding them each time; the first read or the commit rebuilds them
+static bool dates_are_stale;
+
+// Days rolled up out of the record columns, newest first
+static int number_of_archived_days;
+static DailyAggregate archived_days[MAX_NUMBER_OF_ARCHIVED_DAYS];
+
+// Changes made in a transaction stay in RAM until it commits, and only then
+// reach the change log. The log of steps that reverse it names every record
+// the transaction touched, and outlives the commit so it can be undone.
+static bool in_transaction;
+static bool undo_log_is_complete;
+static bool undo_log_overflowed;
+static int number_of_undo_entries;
+static int number_of_logged_undo_entries;
+static UndoEntry undo_log[UNDO_LOG_SIZE];
+
+// Changes the phone has not acknowledged yet, oldest first, at most one per
+// record. Changes up to the floor were dropped for room, so a phone that is
+// behind it needs the whole log again. Persisted as a single value.
+typedef struct {
+  uint32_t sequence;
+  uint32_t floor;
+  Change changes[CHANGE_LOG_SIZE];
+} ChangeLog;
+
+static int number_of_changes;
+static ChangeLog change_log;
+static bool change_log_is_dirty;
+
+// A bulk import only touches RAM until it ends. Records past the columns are
+// folded a day at a time into import_day; records the archive already covers
+// are skipped so they are not counted twice.
+static bool importing;
+static time_t import_archive_cutoff;
+static DailyAggregate import_day;
+
+// Bumped on every change to the records, sessions or archive
+static uint32_t data_version = 1;
+static StoreChangedHandler subscribers[MAX_NUMBER_OF_SUBSCRIBERS];
+
+// Persist unless set otherwise before init; switches to RAM for the rest of
+// the run if persist stops taking writes
+static const StorageBackend *storage = &storage_persist;
+
+// A capacity set in wscript has to fit: no fewer records than the harness
+// checks cover, pages may not run out of keys, and everything persisted and
+// every table has to fit its budget
+_Static_assert(MAX_NUMBER_OF_CONTRACTIONS >= 32,
+  "tools/harness checks the store down to 32 records, and no further");
+_Static_assert(MAX_NUMBER_OF_CONTRACTIONS <= UINT16_MAX,
+  "Record positions are kept in 16 bits");
+_Static_assert(RECORDS_PER_PAGE * sizeof(Contraction) <= PERSIST_DATA_MAX_LENGTH,
+  "A record page has to fit one persisted value");
+_Static_assert(RECORD_PAGE_KEY + NUMBER_OF_RECORD_PAGES <= VERSION_1_MIN_RECORD_KEY,
+  "Record pages have to stay clear of the version 1 record keys, which encode MMDDHHMMSS");
+_Static_assert(sizeof(time_t) != 4 ||
+  (sizeof(Contraction) == WATCH_CONTRACTION_SIZE && sizeof(DailyAggregate) == WATCH_DAILY_AGGREGATE_SIZE &&
+   sizeof(UndoEntry) == WATCH_UNDO_ENTRY_SIZE && sizeof(SessionRange) == WATCH_SESSION_RANGE_SIZE),
+  "The watch sizes the budgets are checked at have to be the sizes on the watch");
+_Static_assert(
+  WATCH_NUMBER_OF_RECORD_PAGES * WATCH_RECORDS_PER_PAGE * WATCH_CONTRACTION_SIZE +
+  WATCH_ARCHIVE_SIZE + sizeof(change_log) + 4 * sizeof(int32_t) <= PERSIST_STORAGE_BUDGET,
+  "Records, archive, change log and counters have to fit the persist budget");
+_Static_assert(
+  sizeof(start_times) + sizeof(durations) + WATCH_RECORDS_PER_PAGE * WATCH_CONTRACTION_SIZE + sizeof(date_window) +
+  MAX_NUMBER_OF_SESSIONS * WATCH_SESSION_RANGE_SIZE + WATCH_ARCHIVE_SIZE +
+  UNDO_LOG_SIZE * WATCH_UNDO_ENTRY_SIZE + sizeof(change_log) <= STORE_RAM_BUDGET,
+  "The store's tables have to fit their share of the app heap");
 
 // Debug
 // static void log_contraction_keys() {
 //   for (int i = 0; i < number_of_contractions; i++) {
-//     app_log(APP_LOG_LEVEL_INFO, "store.c", 166, "contraction_keys[%d] = %d", i, (int)contraction_keys[i]);
+//     app_log(APP_LOG_LEVEL_INFO, "store.c", 166, "start_times[%d] = %d", i, (int)start_times[i]);
 //   }
 // }
 
 // static void log_dates() {
 //   // app_log(APP_LOG_LEVEL_INFO, "store.c", 29, "No of dates: %d", number_of_dates);
-//   for (int i = 0; i < number_of_dates; i++) {
-//     DateRange range = dates[i];
-//     app_log(APP_LOG_LEVEL_INFO, "store.c", 29, "dates[%d] = { .month = %d, .day = %d, .location = %d, .length = %d }", i, range.month, range.day, range.location, range.length);
+//   for (int i = 0; i < date_window_length; i++) {
+//     DateRange range = date_window[i];
+//     app_log(APP_LOG_LEVEL_INFO, "store.c", 29, "dates[%d] = { .month = %d, .day = %d, .location = %d, .length = %d }", date_window_start + i, range.month, range.day, range.location, range.length);
 //   }
 // }
 
 // Static functions
-static uint32_t generate_key_from_time(time_t start_time) {
-  char key[] = "MMDDHHMMSS";
+static void fall_back_to_ram_storage();
+static bool is_same_day(time_t time_a, time_t time_b);
+static void write_archived_days();
+static void archive_aggregate(DailyAggregate aggregate);
+static void refresh_dates();
+
+static bool value_exists(uint32_t key) {
+  return storage->exists(key);
+}
+
+static int read_value(uint32_t key, void *buffer, size_t buffer_size) {
+  return storage->read(key, buffer, buffer_size);
+}
+
+static void write_value(uint32_t key, const void *data, size_t size) {
+  if (storage->write(key, data, size) < 0 && storage != &storage_ram) {
+    fall_back_to_ram_storage();
+  }
+}
 
-  struct tm *start_datetime = localtime(&start_time);
-  snprintf(key, sizeof(key), "%02d%02d%02d%02d%02d",
-    start_datetime->tm_mon,
-    start_datetime->tm_mday,
-    start_datetime->tm_hour,
-    start_datetime->tm_min,
-    start_datetime->tm_sec);
+static void delete_value(uint32_t key) {
+  storage->delete(key);
+}
+
+static int32_t read_int(uint32_t key) {
+  int32_t value = 0;
+  read_value(key, &value, sizeof(value));
+  return value;
+}
+
+static void write_int(uint32_t key, int32_t value) {
+  write_value(key, &value, sizeof(value));
+}
+
+static bool read_bool(uint32_t key) {
+  bool value = false;
+  read_value(key, &value, sizeof(value));
+  return value;
+}
 
-  return atoi(key);
+static void write_bool(uint32_t key, bool value) {
+  write_value(key, &value, sizeof(value));
 }
 
-static DateRange make_date_range(int location, int month, int day) {
+static DateRange make_date_range(int location, int month, int day, int session) {
   DateRange range;
   range.location = location;
   range.length = 1;
   range.month = month;
   range.day = day;
-
-  store_date_for_month_day(range.as_string, sizeof(range.as_string), month, day);
+  range.session = session;
 
   return range;
 }
 
 static bool date_section_is_valid(int date_section) {
-  return date_section >= 0 && date_section < MAX_NUMBER_OF_DATE_SECTIONS;
-}
-
-static void cleanup_contractions() {
-  for (int i = 0; i < MAX_NUMBER_OF_CONTRACTIONS; i++) {
-    uint32_t contraction_key = contraction_keys[i];
-    if (contraction_key != 0) {
-      Contraction contraction;
-      status_t status = store_contraction_for_key(contraction_key, &contraction);
-      if (status != sizeof(Contraction) || contraction.start_time == 0) {
-        // If contraction key does not retrieve usable data, remove contraction key
-        contraction_keys[i] = 0;
+  refresh_dates();
+  return date_section >= 0 && date_section < number_of_dates;
+}
+
+static bool session_is_valid(int session) {
+  refresh_dates();
+  return session >= 0 && session < number_of_sessions;
+}
+
+static Contraction contraction_at(int index) {
+  Contraction contraction;
+  contraction.start_time = start_times[index];
+  contraction.seconds_elapsed = durations[index];
+  return contraction;
+}
+
+static void set_contraction_at(int index, Contraction contraction) {
+  start_times[index] = contraction.start_time;
+  durations[index] = contraction.seconds_elapsed > UINT16_MAX ? UINT16_MAX : contraction.seconds_elapsed;
+}
+
+static void move_contractions(int to_index, int from_index, int count) {
+  memmove(&start_times[to_index], &start_times[from_index], count * sizeof(uint32_t));
+  memmove(&durations[to_index], &durations[from_index], count * sizeof(uint16_t));
+}
+
+// Binary search over the records, which are kept sorted newest first
+static int index_for_key(uint32_t contraction_key) {
+  const time_t start_time = contraction_key;
+
+  if (last_found_index >= 0 && last_found_index < number_of_contractions &&
+      start_times[last_found_index] == start_time) {
+    return last_found_index;
+  }
+
+  int low = 0;
+  int high = number_of_contractions - 1;
+
+  while (low <= high) {
+    int middle = (low + high) / 2;
+    time_t middle_start_time = start_times[middle];
+
+    if (middle_start_time == start_time) {
+      last_found_index = middle;
+      return middle;
+    } else if (middle_start_time > start_time) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+// Index at which a record starting at start_time belongs
+static int insertion_index(time_t start_time) {
+  int low = 0;
+  int high = number_of_contractions;
+
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (start_times[middle] > start_time) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+// Mark records first_index..last_index (newest first) for the next flush
+static void mark_dirty(int first_index, int last_index) {
+  int first_position = number_of_contractions - 1 - last_index;
+  int last_position = number_of_contractions - 1 - first_index;
+
+  if (first_dirty_position < 0 || first_position < first_dirty_position) {
+    first_dirty_position = first_position;
+  }
+  if (last_position > last_dirty_position) {
+    last_dirty_position = last_position;
+  }
+}
+
+static void write_record_page(int page) {
+  int first_position = page * RECORDS_PER_PAGE;
+  int length = number_of_contractions - first_position;
+  if (length > (int)RECORDS_PER_PAGE) {
+    length = RECORDS_PER_PAGE;
+  }
+
+  for (int i = 0; i < length; i++) {
+    page_buffer[i] = contraction_at(number_of_contractions - 1 - (first_position + i));
+  }
+  write_value(RECORD_PAGE_KEY + page, page_buffer, length * sizeof(Contraction));
+}
+
+static void write_change_log() {
+  write_value(CHANGE_LOG_KEY, &change_log, CHANGE_LOG_HEADER_SIZE + number_of_changes * sizeof(Change));
+  change_log_is_dirty = false;
+}
+
+static void load_change_log() {
+  status_t status = read_value(CHANGE_LOG_KEY, &change_log, sizeof(change_log));
+  if (status < (int)CHANGE_LOG_HEADER_SIZE) {
+    // Whatever is on the watch already is the starting point; a phone
+    // catches up on it with a full export
+    change_log.sequence = 1;
+    change_log.floor = 1;
+    number_of_changes = 0;
+    change_log_is_dirty = true;
+    return;
+  }
+
+  number_of_changes = (status - CHANGE_LOG_HEADER_SIZE) / sizeof(Change);
+}
+
+static void remove_change_at_index(int index) {
+  number_of_changes--;
+  memmove(&change_log.changes[index], &change_log.changes[index + 1], (number_of_changes - index) * sizeof(Change));
+}
+
+static void record_change(ChangeKind kind, Contraction contraction) {
+  if (kind == ChangeRemoveAll) {
+    // Supersedes everything before it, so no phone needs a full export
+    number_of_changes = 0;
+    change_log.floor = 0;
+  } else {
+    // Only the latest change to a record matters
+    for (int i = 0; i < number_of_changes; i++) {
+      if (change_log.changes[i].kind != ChangeRemoveAll && change_log.changes[i].start_time == (uint32_t)contraction.start_time) {
+        remove_change_at_index(i);
+        break;
       }
     }
   }
+
+  if (number_of_changes == (int)CHANGE_LOG_SIZE) {
+    change_log.floor = change_log.changes[0].sequence;
+    remove_change_at_index(0);
+  }
+
+  Change *change = &change_log.changes[number_of_changes++];
+  change->sequence = ++change_log.sequence;
+  change->start_time = contraction.start_time;
+  change->seconds_elapsed = contraction.seconds_elapsed > UINT16_MAX ? UINT16_MAX : contraction.seconds_elapsed;
+  change->kind = kind;
+  change_log_is_dirty = true;
 }
 
-static void sort_contractions() {
-  uint32_t temp;
-  int j;
+// Write every dirty page, drop pages past the end and update the count
+static void flush_contractions() {
+  int number_of_pages = (number_of_contractions + RECORDS_PER_PAGE - 1) / RECORDS_PER_PAGE;
+  int number_of_persisted_pages = (number_of_persisted_contractions + RECORDS_PER_PAGE - 1) / RECORDS_PER_PAGE;
 
-  // Insert sort
-  for (int i = 1; i < MAX_NUMBER_OF_CONTRACTIONS; i++) {
-    temp = contraction_keys[i];
-    j = i - 1;
-    while (temp > contraction_keys[j] && j >= 0) {
-      contraction_keys[j + 1] = contraction_keys[j];
-      j--;
+  if (first_dirty_position >= 0 && number_of_contractions > 0) {
+    int last_position = last_dirty_position < number_of_contractions ? last_dirty_position : number_of_contractions - 1;
+    for (int page = first_dirty_position / RECORDS_PER_PAGE; page <= last_position / (int)RECORDS_PER_PAGE; page++) {
+      write_record_page(page);
     }
-    contraction_keys[j + 1] = temp;
   }
 
+  for (int page = number_of_pages; page < number_of_persisted_pages; page++) {
+    delete_value(RECORD_PAGE_KEY + page);
+  }
+
+  if (number_of_contractions != number_of_persisted_contractions) {
+    write_int(RECORD_COUNT_KEY, number_of_contractions);
+    number_of_persisted_contractions = number_of_contractions;
+  }
+
+  first_dirty_position = -1;
+  last_dirty_position = -1;
+
+  if (change_log_is_dirty) {
+    write_change_log();
+  }
+}
+
+// Fold a record into the day being rolled up from records read oldest first
+static void fold_into_day(DailyAggregate *day, Contraction contraction) {
+  if (day->count > 0 && !is_same_day(day->start_time, contraction.start_time)) {
+    archive_aggregate(*day);
+    day->count = 0;
+  }
+
+  if (day->count == 0) {
+    DailyAggregate new_day = {
+      .start_time = contraction.start_time,
+      .min_duration_in_seconds = UINT16_MAX,
+    };
+    *day = new_day;
+  } else {
+    // Start-to-start intervals within the day telescope to this
+    day->total_interval_in_seconds = contraction.start_time - day->start_time;
+  }
+
+  uint16_t seconds_elapsed = contraction.seconds_elapsed > UINT16_MAX ? UINT16_MAX : contraction.seconds_elapsed;
+  day->count++;
+  day->total_duration_in_seconds += seconds_elapsed;
+  if (seconds_elapsed < day->min_duration_in_seconds) {
+    day->min_duration_in_seconds = seconds_elapsed;
+  }
+  if (seconds_elapsed > day->max_duration_in_seconds) {
+    day->max_duration_in_seconds = seconds_elapsed;
+  }
+  day->end_time = contraction.start_time + seconds_elapsed;
+  day->newest_duration_in_seconds = seconds_elapsed;
+}
+
+static void load_contractions() {
+  int count = read_int(RECORD_COUNT_KEY);
+
+  // A log written by a build with a larger capacity keeps its newest records
+  // and rolls the rest up into the archive
+  int first_kept_position = count > MAX_NUMBER_OF_CONTRACTIONS ? count - MAX_NUMBER_OF_CONTRACTIONS : 0;
+  DailyAggregate rolled_up_day = { .count = 0 };
+
+  // Pages are oldest first, so read them in order and reverse afterwards
   number_of_contractions = 0;
-  for (int i = 0; i < MAX_NUMBER_OF_CONTRACTIONS; i++) {
-    if (contraction_keys[i] != 0) {
-      number_of_contractions++;
+  for (int position = 0; position < count; position += RECORDS_PER_PAGE) {
+    status_t status = read_value(RECORD_PAGE_KEY + position / RECORDS_PER_PAGE, page_buffer, sizeof(page_buffer));
+    int length = status > 0 ? status / (int)sizeof(Contraction) : 0;
+
+    for (int i = 0; i < length && position + i < count; i++) {
+      if (page_buffer[i].start_time == 0) {
+        continue;
+      }
+      if (position + i < first_kept_position) {
+        fold_into_day(&rolled_up_day, page_buffer[i]);
+      } else if (number_of_contractions < MAX_NUMBER_OF_CONTRACTIONS) {
+        set_contraction_at(number_of_contractions++, page_buffer[i]);
+      }
     }
+
+    if (length < (int)RECORDS_PER_PAGE) {
+      break;
+    }
+  }
+
+  for (int i = 0; i < number_of_contractions / 2; i++) {
+    Contraction temp = contraction_at(i);
+    set_contraction_at(i, contraction_at(number_of_contractions - 1 - i));
+    set_contraction_at(number_of_contractions - 1 - i, temp);
+  }
+
+  if (rolled_up_day.count > 0) {
+    archive_aggregate(rolled_up_day);
+    write_archived_days();
+  }
+
+  number_of_persisted_contractions = count;
+  if (number_of_contractions != count && number_of_contractions > 0) {
+    // Records were dropped or rolled up, rewrite everything that remains
+    mark_dirty(0, number_of_contractions - 1);
+  }
+}
+
+static void remove_contraction_at_index(int index) {
+  mark_dirty(0, index);
+  number_of_contractions--;
+  move_contractions(index, index + 1, number_of_contractions - index);
+  start_times[number_of_contractions] = 0;
+  last_found_index = -1;
+}
+
+static void rebuild_sessions() {
+  number_of_sessions = 0;
+  memset(sessions, 0, sizeof(sessions));
+
+  // First pass finds the boundaries from the start and duration columns
+  for (int i = 0; i < number_of_contractions; i++) {
+    // Contractions are sorted newest first, so a gap opens between this
+    // contraction's end and the start of the one before it in the array
+    bool starts_session = number_of_sessions == 0 ||
+      (summary_is_session_gap(start_times[i - 1], start_times[i], durations[i]) &&
+       number_of_sessions < MAX_NUMBER_OF_SESSIONS);
+
+    if (starts_session) {
+      sessions[number_of_sessions].location = i;
+      sessions[number_of_sessions].session.end_time = start_times[i] + durations[i];
+      number_of_sessions++;
+    }
+  }
+
+  // Then each session's totals come from the column kernels
+  for (int i = 0; i < number_of_sessions; i++) {
+    int first = sessions[i].location;
+    int end = i < number_of_sessions - 1 ? sessions[i + 1].location : number_of_contractions;
+
+    Session *session = &sessions[i].session;
+    session->start_time = start_times[end - 1];
+    session->count = end - first;
+    session->total_duration_in_seconds = summary_sum_durations(&durations[first], end - first);
+    session->total_interval_in_seconds = summary_total_interval(&start_times[first], end - first);
+  }
+}
+
+static int session_for_location(int location) {
+  int session = 0;
+  while (session < number_of_sessions - 1 && sessions[session + 1].location <= location) {
+    session++;
+  }
+  return session;
+}
+
+// Decode the date section that begins at the given record
+static DateRange date_range_at_location(int location) {
+  int32_t day_index = calendar_day_for_time(start_times[location]);
+
+  int month;
+  int day;
+  calendar_month_day_for_day(day_index, &month, &day);
+  int session = session_for_location(location);
+
+  DateRange range = make_date_range(location, month, day, session);
+
+  // Date sections never span two sessions
+  int end = session < number_of_sessions - 1 ? sessions[session + 1].location : number_of_contractions;
+
+  while (range.location + range.length < end &&
+         calendar_day_for_time(start_times[range.location + range.length]) == day_index) {
+    range.length++;
+  }
+
+  return range;
+}
+
+static void load_date_window(int date_section) {
+  int start = date_section - DATE_WINDOW_SIZE / 2;
+  if (start < 0) {
+    start = 0;
+  }
+
+  // Resume from the current window when paging forwards, otherwise rescan
+  int section = 0;
+  int location = 0;
+  if (date_window_length > 0 && start >= date_window_start) {
+    section = date_window_start;
+    location = date_window[0].location;
+  }
+
+  while (section < start) {
+    location += date_range_at_location(location).length;
+    section++;
+  }
+
+  date_window_start = start;
+  date_window_length = 0;
+  while (date_window_length < DATE_WINDOW_SIZE && location < number_of_contractions) {
+    DateRange range = date_range_at_location(location);
+    date_window[date_window_length++] = range;
+    location += range.length;
   }
 }
 
+static DateRange date_range_for_date_section(int date_section) {
+  if (date_section < date_window_start || date_section >= date_window_start + date_window_length) {
+    load_date_window(date_section);
+  }
+  return date_window[date_section - date_window_start];
+}
+
 static void rebuild_dates() {
+  rebuild_sessions();
+
+  // Count every date section, but only keep the first window decoded
   number_of_dates = 0;
-  memset(dates, 0, sizeof(dates));
+  date_window_start = 0;
+  date_window_length = 0;
 
-  for (int i = 0; i < number_of_contractions; i++) {
-    uint32_t contraction_key = contraction_keys[i];
+  int location = 0;
+  while (location < number_of_contractions) {
+    DateRange range = date_range_at_location(location);
+
+    SessionRange *session = &sessions[range.session];
+    if (session->number_of_date_sections == 0) {
+      session->first_date_section = number_of_dates;
+    }
+    session->number_of_date_sections++;
+
+    if (date_window_length < DATE_WINDOW_SIZE) {
+      date_window[date_window_length++] = range;
+    }
+
+    location += range.length;
+    number_of_dates++;
+  }
+  dates_are_stale = false;
+  // log_dates();
+}
+
+static void refresh_dates() {
+  if (dates_are_stale) {
+    rebuild_dates();
+  }
+}
+
+static void data_changed() {
+  rebuild_dates();
+
+  data_version++;
+  for (int i = 0; i < MAX_NUMBER_OF_SUBSCRIBERS; i++) {
+    if (subscribers[i] != NULL) {
+      subscribers[i](data_version);
+    }
+  }
+}
+
+static bool is_same_day(time_t time_a, time_t time_b) {
+  return calendar_day_for_time(time_a) == calendar_day_for_time(time_b);
+}
+
+static void write_archived_days() {
+  if (number_of_archived_days > 0) {
+    write_value(ARCHIVE_KEY, archived_days, number_of_archived_days * sizeof(DailyAggregate));
+  } else if (value_exists(ARCHIVE_KEY)) {
+    delete_value(ARCHIVE_KEY);
+  }
+}
+
+// Everything the store holds is in RAM already, so it is written out again
+// and the app carries on as before; only keeping it past exit is lost.
+// Records an unfinished migration has not reached stay behind in persist.
+static void fall_back_to_ram_storage() {
+  APP_LOG(APP_LOG_LEVEL_WARNING, "Persist is not taking writes, keeping the log in RAM");
+  bool disclaimer_shown = value_exists(DISCLAIMER_SHOWN_KEY) && read_bool(DISCLAIMER_SHOWN_KEY);
+  storage = &storage_ram;
+
+  write_bool(DISCLAIMER_SHOWN_KEY, disclaimer_shown);
+  write_int(SCHEMA_VERSION_KEY, schema_version);
+  write_archived_days();
+
+  number_of_persisted_contractions = 0;
+  if (number_of_contractions > 0) {
+    mark_dirty(0, number_of_contractions - 1);
+  }
+  change_log_is_dirty = true;
+  flush_contractions();
+}
+
+static time_t newest_start_time_of_day(const DailyAggregate *day) {
+  return day->end_time - day->newest_duration_in_seconds;
+}
+
+// Start-to-start intervals telescope within a day, so two parts of one day
+// also get the gap from the older part's newest start to the newer part's
+// first. Nothing is added across two days folded together for room, nor
+// for a part that falls within the span of the other.
+static void merge_aggregate(DailyAggregate *newer, DailyAggregate older) {
+  time_t older_newest_start_time = newest_start_time_of_day(&older);
+  if (newer->start_time > older_newest_start_time && is_same_day(newer->start_time, older_newest_start_time)) {
+    newer->total_interval_in_seconds += newer->start_time - older_newest_start_time;
+  }
+  if (older_newest_start_time > newest_start_time_of_day(newer)) {
+    newer->end_time = older.end_time;
+    newer->newest_duration_in_seconds = older.newest_duration_in_seconds;
+  }
+
+  newer->start_time = older.start_time;
+  newer->count += older.count;
+  newer->total_duration_in_seconds += older.total_duration_in_seconds;
+  newer->total_interval_in_seconds += older.total_interval_in_seconds;
+  if (older.min_duration_in_seconds < newer->min_duration_in_seconds) {
+    newer->min_duration_in_seconds = older.min_duration_in_seconds;
+  }
+  if (older.max_duration_in_seconds > newer->max_duration_in_seconds) {
+    newer->max_duration_in_seconds = older.max_duration_in_seconds;
+  }
+}
+
+// File a day into archived_days[], which is sorted newest first
+static void archive_aggregate(DailyAggregate aggregate) {
+  int index = 0;
+  while (index < number_of_archived_days && archived_days[index].start_time > aggregate.start_time) {
+    index++;
+  }
+
+  // Part of this day was archived before
+  if (index > 0 && is_same_day(archived_days[index - 1].start_time, aggregate.start_time)) {
+    merge_aggregate(&archived_days[index - 1], aggregate);
+    return;
+  }
+  if (index < number_of_archived_days && is_same_day(archived_days[index].start_time, aggregate.start_time)) {
+    DailyAggregate older = archived_days[index];
+    archived_days[index] = aggregate;
+    merge_aggregate(&archived_days[index], older);
+    return;
+  }
+
+  if (number_of_archived_days == (int)MAX_NUMBER_OF_ARCHIVED_DAYS) {
+    if (index == number_of_archived_days) {
+      // Older than everything kept: fold it into the oldest day
+      merge_aggregate(&archived_days[index - 1], aggregate);
+      return;
+    }
+    // Out of room: fold the two oldest days together rather than drop one
+    number_of_archived_days--;
+    merge_aggregate(&archived_days[number_of_archived_days - 1], archived_days[number_of_archived_days]);
+  }
+
+  memmove(&archived_days[index + 1], &archived_days[index], (number_of_archived_days - index) * sizeof(DailyAggregate));
+  archived_days[index] = aggregate;
+  number_of_archived_days++;
+}
+
+// Roll the records from first to the end, the oldest ones, up into
+// archived_days[]; they all fall on one day
+static void archive_from_index(int first) {
+  int last = number_of_contractions - 1;
+
+  // Every remaining record moves down in the persisted order
+  mark_dirty(0, last);
+
+  DailyAggregate aggregate = {
+    .start_time = start_times[last],
+    .end_time = start_times[first] + durations[first],
+    .min_duration_in_seconds = UINT16_MAX,
+    .newest_duration_in_seconds = durations[first],
+    // Start-to-start intervals within the day telescope to this
+    .total_interval_in_seconds = start_times[first] - start_times[last],
+  };
+
+  for (int i = first; i <= last; i++) {
+    int seconds_elapsed = durations[i];
+    aggregate.count++;
+    aggregate.total_duration_in_seconds += seconds_elapsed;
+    if (seconds_elapsed < aggregate.min_duration_in_seconds) {
+      aggregate.min_duration_in_seconds = seconds_elapsed;
+    }
+    if (seconds_elapsed > aggregate.max_duration_in_seconds) {
+      aggregate.max_duration_in_seconds = seconds_elapsed;
+    }
+
+    start_times[i] = 0;
+  }
+  number_of_contractions = first;
+  last_found_index = -1;
+
+  archive_aggregate(aggregate);
+}
+
+static int first_index_of_oldest_day() {
+  int last = number_of_contractions - 1;
+  int first = last;
+  while (first > 0 && is_same_day(start_times[first - 1], start_times[last])) {
+    first--;
+  }
+  return first;
+}
+
+// Roll the oldest day of records up into archived_days[]
+static void archive_oldest_day() {
+  archive_from_index(first_index_of_oldest_day());
+}
+
+// Make room for one more record. The oldest day is rolled up whole only if
+// it is over and has no part in the newest session; otherwise just the
+// oldest record goes, so a full store keeps the labor in progress.
+static void archive_to_make_room() {
+  int first = first_index_of_oldest_day();
+  int newest_session_length = summary_newest_session_length(start_times, durations, number_of_contractions);
+
+  if (!calendar_is_today(start_times[number_of_contractions - 1]) && first >= newest_session_length) {
+    archive_from_index(first);
+  } else {
+    archive_from_index(number_of_contractions - 1);
+  }
+}
+
+// Archive whole days older than ARCHIVE_AGE_IN_SECONDS. When forced and
+// nothing is that old, room is made for a new record anyway.
+static bool archive_old_contractions(bool force) {
+  const time_t time_cutoff = time(NULL) - ARCHIVE_AGE_IN_SECONDS;
+  bool archived = false;
+
+  while (number_of_contractions > 0 && start_times[number_of_contractions - 1] < time_cutoff) {
+    archive_oldest_day();
+    archived = true;
+  }
+
+  if (!archived && force && number_of_contractions > 0) {
+    archive_to_make_room();
+    archived = true;
+  }
+
+  if (archived) {
+    write_archived_days();
+  }
+  return archived;
+}
+
+static void log_undo(UndoKind kind, Contraction contraction) {
+  if (number_of_undo_entries == UNDO_LOG_SIZE) {
+    undo_log_is_complete = false;
+    undo_log_overflowed = true;
+    return;
+  }
+
+  undo_log[number_of_undo_entries].kind = kind;
+  undo_log[number_of_undo_entries].contraction = contraction;
+  number_of_undo_entries++;
+}
+
+// Log how to reverse putting a record at this start time
+static void log_undo_put(time_t start_time) {
+  int index = index_for_key(start_time);
+  if (index >= 0) {
+    log_undo(UndoPut, contraction_at(index));
+  } else {
+    Contraction contraction = { .start_time = start_time };
+    log_undo(UndoRemove, contraction);
+  }
+}
+
+// Log for sync where each record named by the first number_of_entries undo
+// entries now stands. A transaction that outgrew the undo log touched records nobody
+// can name, so every phone starts over with a full export.
+static void log_staged_changes(int number_of_entries) {
+  if (undo_log_overflowed) {
+    number_of_changes = 0;
+    change_log.sequence++;
+    change_log.floor = change_log.sequence;
+    change_log_is_dirty = true;
+  } else {
+    for (int i = number_of_logged_undo_entries; i < number_of_entries; i++) {
+      int index = index_for_key(undo_log[i].contraction.start_time);
+      if (index >= 0) {
+        record_change(ChangePut, contraction_at(index));
+      } else {
+        record_change(ChangeRemove, undo_log[i].contraction);
+      }
+    }
+  }
+  number_of_logged_undo_entries = number_of_entries;
+}
+
+// Fold an imported record that is older than everything in the columns
+static void import_into_archive(Contraction contraction) {
+  int seconds_elapsed = contraction.seconds_elapsed > UINT16_MAX ? UINT16_MAX : contraction.seconds_elapsed;
+
+  if (import_day.count > 0 && contraction.start_time < import_day.start_time && is_same_day(import_day.start_time, contraction.start_time)) {
+    import_day.total_interval_in_seconds += import_day.start_time - contraction.start_time;
+    import_day.start_time = contraction.start_time;
+  } else {
+    if (import_day.count > 0) {
+      archive_aggregate(import_day);
+    }
+    DailyAggregate day = {
+      .start_time = contraction.start_time,
+      .end_time = contraction.start_time + seconds_elapsed,
+      .min_duration_in_seconds = UINT16_MAX,
+      .newest_duration_in_seconds = seconds_elapsed,
+    };
+    import_day = day;
+  }
 
+  import_day.count++;
+  import_day.total_duration_in_seconds += seconds_elapsed;
+  if (seconds_elapsed < import_day.min_duration_in_seconds) {
+    import_day.min_duration_in_seconds = seconds_elapsed;
+  }
+  if (seconds_elapsed > import_day.max_duration_in_seconds) {
+    import_day.max_duration_in_seconds = seconds_elapsed;
+  }
+}
+
+static bool begin_change() {
+  if (in_transaction) {
+    return false;
+  }
+
+  store_begin_transaction();
+  return true;
+}
+
+static void end_change(bool began) {
+  if (began) {
+    store_commit_transaction();
+  } else {
+    // Readers in the middle of a transaction see its sections as they are
+    dates_are_stale = true;
+  }
+}
+
+// Insert a record in order, or overwrite the one with the same start time
+static void put_contraction(Contraction contraction) {
+  int index = index_for_key(contraction.start_time);
+
+  if (index >= 0) {
+    set_contraction_at(index, contraction);
+    mark_dirty(index, index);
+  } else {
+    if (number_of_contractions == MAX_NUMBER_OF_CONTRACTIONS) {
+      // Archived days cannot be put back, so what is staged so far becomes
+      // durable and can no longer be reversed. The undo entry of this record
+      // is logged when the transaction commits.
+      if (in_transaction) {
+        log_staged_changes(number_of_undo_entries - 1);
+      }
+      if (archive_old_contractions(true)) {
+        flush_contractions();
+        undo_log_is_complete = false;
+      }
+    }
+
+    index = insertion_index(contraction.start_time);
+    move_contractions(index + 1, index, number_of_contractions - index);
+    set_contraction_at(index, contraction);
+    number_of_contractions++;
+    last_found_index = -1;
+    mark_dirty(0, index);
+  }
+}
+
+// Newest step first; RAM only, and the entries are kept
+static void apply_undo_log() {
+  for (int i = number_of_undo_entries - 1; i >= 0; i--) {
+    UndoEntry entry = undo_log[i];
+    if (entry.kind == UndoPut) {
+      put_contraction(entry.contraction);
+    } else {
+      int index = index_for_key(entry.contraction.start_time);
+      if (index >= 0) {
+        remove_contraction_at_index(index);
+      }
+    }
+  }
+}
+
+// Migrations
+static bool migrate_from_version_1() {
+  uint32_t keys[VERSION_1_MAX_NUMBER_OF_CONTRACTIONS];
+  status_t status = read_value(CONTRACTIONS_KEY, keys, sizeof(keys));
+  int number_of_keys = status > 0 ? status / (int)sizeof(uint32_t) : 0;
+
+  int end = migration_progress + MIGRATION_CHUNK_SIZE;
+  if (end > number_of_keys) {
+    end = number_of_keys;
+  }
+
+  bool archived = false;
+  for (int i = migration_progress; i < end; i++) {
     Contraction contraction;
-    status_t status = store_contraction_for_key(contraction_key, &contraction);
-
-    if (status == sizeof(Contraction)) {
-      time_t start_time = contraction.start_time;
-      struct tm *date_time = localtime(&start_time);
-
-      int month = date_time->tm_mon;
-      int day = date_time->tm_mday;
-
-      DateRange range;
-      if (number_of_dates > 0) {
-        range = dates[number_of_dates - 1];
-        if (range.month == month && range.day == day) {
-          range.length++;
-          dates[number_of_dates - 1] = range;
-        } else if (number_of_dates < MAX_NUMBER_OF_DATE_SECTIONS) {
-          range = make_date_range(i, month, day);
-          dates[number_of_dates] = range;
-          number_of_dates++;
-        }
+    if (keys[i] != 0 &&
+        read_value(keys[i], &contraction, sizeof(Contraction)) == sizeof(Contraction) &&
+        contraction.start_time != 0) {
+      if (number_of_contractions == MAX_NUMBER_OF_CONTRACTIONS && contraction.start_time < (time_t)start_times[number_of_contractions - 1]) {
+        // Older than everything a smaller capacity keeps in detail
+        DailyAggregate day = { .count = 0 };
+        fold_into_day(&day, contraction);
+        archive_aggregate(day);
+        archived = true;
       } else {
-        range = make_date_range(i, month, day);
-        dates[0] = range;
-        number_of_dates++;
+        put_contraction(contraction);
       }
     }
   }
-  // log_dates();
+  if (archived) {
+    write_archived_days();
+  }
+
+  // Pages first, then drop the old keys, then record progress. Re-running a
+  // chunk after being killed only overwrites records that were already moved.
+  flush_contractions();
+  for (int i = migration_progress; i < end; i++) {
+    if (keys[i] != 0) {
+      delete_value(keys[i]);
+    }
+  }
+  migration_progress = end;
+  write_int(MIGRATION_PROGRESS_KEY, migration_progress);
+
+  if (migration_progress < number_of_keys) {
+    return false;
+  }
+
+  delete_value(CONTRACTIONS_KEY);
+  return true;
+}
+
+static void discard_version_1() {
+  uint32_t keys[VERSION_1_MAX_NUMBER_OF_CONTRACTIONS];
+  status_t status = read_value(CONTRACTIONS_KEY, keys, sizeof(keys));
+  int number_of_keys = status > 0 ? status / (int)sizeof(uint32_t) : 0;
+
+  for (int i = migration_progress; i < number_of_keys; i++) {
+    if (keys[i] != 0) {
+      delete_value(keys[i]);
+    }
+  }
+  delete_value(CONTRACTIONS_KEY);
+}
+
+static const Migration migrations[] = {
+  { .from_version = 1, .step = migrate_from_version_1, .discard = discard_version_1 },
+};
+
+static const Migration *migration_for_version(int version) {
+  for (size_t i = 0; i < sizeof(migrations) / sizeof(Migration); i++) {
+    if (migrations[i].from_version == version) {
+      return &migrations[i];
+    }
+  }
+  return NULL;
+}
+
+static void finish_migration_step() {
+  schema_version++;
+  migration_progress = 0;
+  write_int(SCHEMA_VERSION_KEY, schema_version);
+  delete_value(MIGRATION_PROGRESS_KEY);
+}
+
+static void migration_timer_callback(void *data) {
+  migration_timer = NULL;
+
+  if (in_transaction) {
+    migration_timer = app_timer_register(MIGRATION_CHUNK_DELAY, migration_timer_callback, NULL);
+    return;
+  }
+
+  // Converted records are not in the undo log
+  number_of_undo_entries = 0;
+
+  const Migration *migration = migration_for_version(schema_version);
+  if (migration == NULL) {
+    // Unknown layout, nothing can be converted
+    finish_migration_step();
+  } else if (migration->step()) {
+    finish_migration_step();
+  }
+
+  if (schema_version < SCHEMA_VERSION) {
+    migration_timer = app_timer_register(MIGRATION_CHUNK_DELAY, migration_timer_callback, NULL);
+  } else {
+    archive_old_contractions(false);
+    flush_contractions();
+  }
+
+  data_changed();
+}
+
+// Throw away whatever has not been converted yet
+static void discard_migrations() {
+  if (migration_timer != NULL) {
+    app_timer_cancel(migration_timer);
+    migration_timer = NULL;
+  }
+
+  while (schema_version < SCHEMA_VERSION) {
+    const Migration *migration = migration_for_version(schema_version);
+    if (migration != NULL) {
+      migration->discard();
+    }
+    finish_migration_step();
+  }
 }
 
 // Non-static functions
@@ -169,6 +1146,10 @@ void store_time_for_time(char *buffer, size_t size, int hour, int minute, int se
   }
 }
 
+void store_time_for_seconds_into_day(char *buffer, size_t size, int seconds) {
+  store_time_for_time(buffer, size, seconds / (60 * 60), seconds / 60 % 60, seconds % 60);
+}
+
 void store_date_for_month_day(char *buffer, size_t size, int month, int day) {
   char month_name[4];
   
@@ -230,13 +1211,11 @@ void store_time_text_for_contraction(char *start_time_buffer, size_t start_time_
   status_t status = store_contraction_for_key(contraction_key, &contraction);
 
   if (status == sizeof(Contraction)) {
-    struct tm *start_datetime = localtime(&contraction.start_time);
-    store_time_for_time(start_time_buffer, start_time_size, start_datetime->tm_hour, start_datetime->tm_min, start_datetime->tm_sec);
+    store_time_for_seconds_into_day(start_time_buffer, start_time_size, calendar_seconds_into_day(contraction.start_time));
 
     contraction.start_time += contraction.seconds_elapsed;
 
-    struct tm *end_datetime = localtime(&contraction.start_time);
-    store_time_for_time(end_time_buffer, end_time_size, end_datetime->tm_hour, end_datetime->tm_min, end_datetime->tm_sec);
+    store_time_for_seconds_into_day(end_time_buffer, end_time_size, calendar_seconds_into_day(contraction.start_time));
   }
 }
 
@@ -278,19 +1257,18 @@ int store_number_of_past_contractions() {
 }
 
 int store_number_of_date_sections() {
+  refresh_dates();
   return number_of_dates;
 }
 
 void store_date_for_date_section(char *date_as_string, size_t num, int date_section) {
   if (date_as_string != NULL && num > 0 && date_section_is_valid(date_section)) {
+    DateRange range = date_range_for_date_section(date_section);
+    // Formatted on demand rather than kept alongside every decoded section
     char date_text[] = "Jan 01";
-    DateRange range = dates[date_section];
-    strcpy(date_text, range.as_string);
+    store_date_for_month_day(date_text, sizeof(date_text), range.month, range.day);
 
-    time_t current_time = time(NULL);
-    struct tm *now = localtime(&current_time);
-
-    if (range.month == now->tm_mon && range.day == now->tm_mday) {
+    if (calendar_is_today(start_times[range.location])) {
       snprintf(date_as_string, num, "Today, %s", date_text);
     } else {
       snprintf(date_as_string, num, "%s", date_text);
@@ -298,9 +1276,59 @@ void store_date_for_date_section(char *date_as_string, size_t num, int date_sect
   }
 }
 
+int store_session_for_date_section(int date_section) {
+  if (date_section_is_valid(date_section)) {
+    return date_range_for_date_section(date_section).session;
+  }
+  return 0;
+}
+
+int store_first_date_section_for_session(int session) {
+  if (session_is_valid(session)) {
+    return sessions[session].first_date_section;
+  }
+  return 0;
+}
+
+int store_number_of_date_sections_for_session(int session) {
+  if (session_is_valid(session)) {
+    return sessions[session].number_of_date_sections;
+  }
+  return 0;
+}
+
+int store_number_of_sessions() {
+  refresh_dates();
+  return number_of_sessions;
+}
+
+int store_number_of_archived_days() {
+  return number_of_archived_days;
+}
+
+bool store_archived_day(int archived_day, DailyAggregate *result) {
+  if (archived_day >= 0 && archived_day < number_of_archived_days) {
+    *result = archived_days[archived_day];
+    return true;
+  }
+  return false;
+}
+
+time_t store_archive_cutoff() {
+  return number_of_archived_days > 0 ? archived_days[0].end_time : 0;
+}
+
+bool store_session(int session, Session *result) {
+  if (session_is_valid(session)) {
+    *result = sessions[session].session;
+    return true;
+  }
+  return false;
+}
+
 int store_number_of_contractions_for_date_section(int date_section) {
   if (date_section_is_valid(date_section)) {
-    DateRange range = dates[date_section];
+    DateRange range = date_range_for_date_section(date_section);
     return range.length;
   }
   return 0;
@@ -308,11 +1336,11 @@ int store_number_of_contractions_for_date_section(int date_section) {
 
 int store_contraction_for_date_section_index(int date_section, int contraction_index, Contraction *contraction) {
   if (date_section_is_valid(date_section)) {
-    DateRange range = dates[date_section];
+    DateRange range = date_range_for_date_section(date_section);
 
     if (contraction_index < range.length) {
-      uint32_t contraction_key = contraction_keys[range.location + contraction_index];
-      return store_contraction_for_key(contraction_key, contraction);    
+      *contraction = contraction_at(range.location + contraction_index);
+      return sizeof(Contraction);
     } else {
       return E_INVALID_ARGUMENT;
     }
@@ -320,13 +1348,32 @@ int store_contraction_for_date_section_index(int date_section, int contraction_i
   return E_INVALID_ARGUMENT;
 }
 
+// Records are indexed newest first
+bool store_contraction_at_index(int index, Contraction *contraction) {
+  if (index < 0 || index >= number_of_contractions) {
+    return false;
+  }
+
+  *contraction = contraction_at(index);
+  return true;
+}
+
 uint32_t store_contraction_key(int date_section, int contraction_index) {
-  DateRange range = dates[date_section];
-  return contraction_keys[range.location + contraction_index];
+  if (!date_section_is_valid(date_section)) {
+    return 0;
+  }
+  DateRange range = date_range_for_date_section(date_section);
+  return start_times[range.location + contraction_index];
 }
 
 status_t store_contraction_for_key(uint32_t contraction_key, Contraction *contraction) {
-  return persist_read_data(contraction_key, contraction, sizeof(Contraction));
+  int index = index_for_key(contraction_key);
+  if (index < 0) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  *contraction = contraction_at(index);
+  return sizeof(Contraction);
 }
 
 status_t store_contractions_for_key(
@@ -335,29 +1382,25 @@ status_t store_contractions_for_key(
   Contraction *previous_contraction,
   Contraction *next_contraction) {
 
-  sort_contractions();
   previous_contraction->start_time = 0;
   next_contraction->start_time = 0;
 
-  for (int i = 0; i < number_of_contractions; i++) {
-    uint32_t key = contraction_keys[i];
-
-    if (key == contraction_key) {
-      if (i > 0) {
-        uint32_t next_contraction_key = contraction_keys[i - 1];
-        store_contraction_for_key(next_contraction_key, next_contraction);
-      }
+  int index = index_for_key(contraction_key);
+  if (index < 0) {
+    return E_DOES_NOT_EXIST;
+  }
 
-      if (i < (number_of_contractions - 1)) {
-        uint32_t previous_contraction_key = contraction_keys[i + 1];
-        store_contraction_for_key(previous_contraction_key, previous_contraction);
-      }
+  // Keys are sorted newest first, so the next contraction sits before this one
+  if (index > 0) {
+    *next_contraction = contraction_at(index - 1);
+  }
 
-      break;
-    }
+  if (index < (number_of_contractions - 1)) {
+    *previous_contraction = contraction_at(index + 1);
   }
 
-  return store_contraction_for_key(contraction_key, contraction);
+  *contraction = contraction_at(index);
+  return sizeof(Contraction);
 }
 
 uint32_t store_insert_contraction(time_t start_time, int seconds_elapsed) {
@@ -365,126 +1408,378 @@ uint32_t store_insert_contraction(time_t start_time, int seconds_elapsed) {
   contraction.start_time = start_time;
   contraction.seconds_elapsed = seconds_elapsed;
 
-  uint32_t contraction_key = generate_key_from_time(start_time);
-  status_t status = persist_write_data(contraction_key, &contraction, sizeof(Contraction));
+  bool began = begin_change();
+  log_undo_put(start_time);
+  put_contraction(contraction);
+  end_change(began);
 
-  if (status == sizeof(Contraction)) {
-    bool found = false;
-    for (int i = 0; i < number_of_contractions; i++) {
-      if (contraction_keys[i] == contraction_key) {
-        found = true;
-        break;
-      }
-    }
+  return start_time;
+}
 
-    if (!found) {
-      if (number_of_contractions == MAX_NUMBER_OF_CONTRACTIONS) {
-        contraction_keys[number_of_contractions - 1] = contraction_key;
-      } else {
-        contraction_keys[number_of_contractions] = contraction_key;
-        number_of_contractions++;
-      }
+uint32_t store_replace_contraction(uint32_t old_contraction_key, time_t new_start_time, int seconds_elapsed) {
+  int old_index = index_for_key(old_contraction_key);
+  if (old_index < 0) {
+    return store_insert_contraction(new_start_time, seconds_elapsed);
+  }
+
+  Contraction contraction;
+  contraction.start_time = new_start_time;
+  contraction.seconds_elapsed = seconds_elapsed;
+
+  uint32_t contraction_key = new_start_time;
+
+  bool began = begin_change();
+  log_undo(UndoPut, contraction_at(old_index));
+
+  if (contraction_key == old_contraction_key) {
+    // Same start time: the record keeps its position, only session totals change
+    set_contraction_at(old_index, contraction);
+    mark_dirty(old_index, old_index);
+    end_change(began);
+    return contraction_key;
+  }
+
+  log_undo_put(new_start_time);
+
+  int new_index = index_for_key(contraction_key);
+  if (new_index >= 0) {
+    // Moved onto an existing record, which it overwrites
+    set_contraction_at(new_index, contraction);
+    mark_dirty(new_index, new_index);
+    remove_contraction_at_index(old_index);
+  } else {
+    // Shift only the records between the old and new position
+    new_index = old_index;
+    while (new_index > 0 && start_times[new_index - 1] < new_start_time) {
+      move_contractions(new_index, new_index - 1, 1);
+      new_index--;
     }
+    while (new_index < number_of_contractions - 1 && start_times[new_index + 1] > new_start_time) {
+      move_contractions(new_index, new_index + 1, 1);
+      new_index++;
+    }
+    set_contraction_at(new_index, contraction);
 
-    sort_contractions();
-    rebuild_dates();
+    if (new_index < old_index) {
+      mark_dirty(new_index, old_index);
+    } else {
+      mark_dirty(old_index, new_index);
+    }
   }
 
+  last_found_index = -1;
+  end_change(began);
+
   return contraction_key;
 }
 
-uint32_t store_replace_contraction(uint32_t old_contraction_key, time_t new_start_time, int seconds_elapsed) {
-  store_remove_contraction(old_contraction_key);
-  return store_insert_contraction(new_start_time, seconds_elapsed);
+void store_remove_contraction(time_t start_time) {
+  int index = index_for_key(start_time);
+  if (index >= 0) {
+    bool began = begin_change();
+    log_undo(UndoPut, contraction_at(index));
+    remove_contraction_at_index(index);
+    end_change(began);
+  }
 }
 
-void store_remove_contraction(time_t start_time) {
-  if (persist_exists(start_time)) {
-    persist_delete(start_time);    
+void store_remove_all_contractions() {
+  discard_migrations();
+
+  // Nothing staged survives, and there is nothing left to undo into
+  in_transaction = false;
+  number_of_undo_entries = 0;
+  importing = false;
+
+  Contraction nothing = { 0 };
+  record_change(ChangeRemoveAll, nothing);
+
+  mark_dirty(0, number_of_contractions - 1);
+  memset(start_times, 0, sizeof(start_times));
+  memset(durations, 0, sizeof(durations));
+  number_of_contractions = 0;
+  last_found_index = -1;
+  flush_contractions();
+
+  number_of_archived_days = 0;
+  write_archived_days();
+
+  data_changed();
+}
+
+void store_begin_transaction() {
+  if (in_transaction) {
+    return;
   }
 
-  for (int i = 0; i < number_of_contractions; i++) {
-    if (contraction_keys[i] == (uint32_t)start_time) {
-      contraction_keys[i] = 0;
-      break;
+  in_transaction = true;
+  undo_log_is_complete = true;
+  undo_log_overflowed = false;
+  number_of_undo_entries = 0;
+  number_of_logged_undo_entries = 0;
+}
+
+void store_commit_transaction() {
+  if (!in_transaction) {
+    return;
+  }
+
+  in_transaction = false;
+  if (number_of_undo_entries > 0 || !undo_log_is_complete) {
+    log_staged_changes(number_of_undo_entries);
+    flush_contractions();
+    data_changed();
+  }
+}
+
+void store_abort_transaction() {
+  if (!in_transaction) {
+    return;
+  }
+
+  // Nothing staged reached the change log, so the sync sequence stays put
+  in_transaction = false;
+  if (undo_log_is_complete) {
+    // Nothing was written since the last commit, so undoing in RAM brings
+    // back exactly what is on flash
+    apply_undo_log();
+    number_of_undo_entries = 0;
+    first_dirty_position = -1;
+    last_dirty_position = -1;
+    rebuild_dates();
+  } else {
+    number_of_undo_entries = 0;
+    load_contractions();
+    load_change_log();
+    data_changed();
+  }
+}
+
+uint32_t store_sync_sequence() {
+  return change_log.sequence;
+}
+
+bool store_can_sync_from(uint32_t sequence) {
+  return sequence > 0 && sequence >= change_log.floor && sequence <= change_log.sequence;
+}
+
+bool store_next_change(uint32_t after_sequence, Change *change) {
+  for (int i = 0; i < number_of_changes; i++) {
+    if (change_log.changes[i].sequence > after_sequence) {
+      *change = change_log.changes[i];
+      return true;
     }
   }
+  return false;
+}
 
-  sort_contractions();
-  rebuild_dates();
+void store_acknowledge_changes(uint32_t sequence) {
+  if (!store_can_sync_from(sequence)) {
+    return;
+  }
+
+  // Acknowledged changes, tombstones included, are no longer needed
+  int acknowledged = 0;
+  while (acknowledged < number_of_changes && change_log.changes[acknowledged].sequence <= sequence) {
+    acknowledged++;
+  }
+
+  number_of_changes -= acknowledged;
+  memmove(change_log.changes, &change_log.changes[acknowledged], number_of_changes * sizeof(Change));
+  change_log.floor = sequence;
+  write_change_log();
 }
 
-void store_remove_all_contractions() {
-  sort_contractions();
-  for (int i = 0; i < number_of_contractions; ++i) {
-    uint32_t start_time = contraction_keys[i];
-    if (persist_exists(start_time)) {
-      persist_delete(start_time);
+bool store_begin_import() {
+  // The columns are not all loaded until the migration finishes
+  if (migration_timer != NULL) {
+    return false;
+  }
+
+  store_commit_transaction();
+  importing = true;
+  import_archive_cutoff = store_archive_cutoff();
+  import_day.count = 0;
+  return true;
+}
+
+void store_import_contraction(time_t start_time, int seconds_elapsed) {
+  if (!importing || start_time <= import_archive_cutoff || index_for_key(start_time) >= 0) {
+    // What the watch already has wins
+    return;
+  }
+
+  Contraction contraction;
+  contraction.start_time = start_time;
+  contraction.seconds_elapsed = seconds_elapsed;
+
+  if (number_of_contractions == 0 || (time_t)start_times[number_of_contractions - 1] > start_time) {
+    if (number_of_contractions < MAX_NUMBER_OF_CONTRACTIONS) {
+      // Records sent newest first land at the end without moving any others
+      set_contraction_at(number_of_contractions, contraction);
+      number_of_contractions++;
+      last_found_index = -1;
+    } else {
+      import_into_archive(contraction);
     }
-    contraction_keys[i] = 0;
+    return;
   }
 
-  sort_contractions();
-  rebuild_dates();
+  if (number_of_contractions == MAX_NUMBER_OF_CONTRACTIONS) {
+    archive_to_make_room();
+  }
+  put_contraction(contraction);
 }
 
-SummaryResult store_calculate_summary(int minutes) {
-  SummaryResult result;
+void store_end_import() {
+  if (!importing) {
+    return;
+  }
 
-  const time_t current_time = time(NULL);
-  const time_t time_cutoff = current_time - 60 * minutes;
+  importing = false;
+  if (import_day.count > 0) {
+    archive_aggregate(import_day);
+    import_day.count = 0;
+  }
 
-  int duration = 0;
-  int interval = 0;
-  int last_start_time = 0;
+  // Write the records and the archive once, a page at a time
+  if (!archive_old_contractions(false)) {
+    write_archived_days();
+  }
+  mark_dirty(0, number_of_contractions - 1);
+  flush_contractions();
+
+  // The change log cannot describe an import, so every phone starts over
+  // with a full export
+  number_of_undo_entries = 0;
+  number_of_changes = 0;
+  change_log.sequence++;
+  change_log.floor = change_log.sequence;
+  write_change_log();
+
+  data_changed();
+}
 
-  for (int i = 0; i < number_of_contractions; i++) {
-    Contraction contraction;
-    store_contraction_for_key(contraction_keys[i], &contraction);
-    if (contraction.start_time >= time_cutoff) {
-      result.count++;
+bool store_can_undo() {
+  return !in_transaction && undo_log_is_complete && number_of_undo_entries > 0;
+}
 
-      duration += contraction.seconds_elapsed;
+bool store_undo_last_transaction() {
+  if (!store_can_undo()) {
+    return false;
+  }
 
-      if (last_start_time != 0) {
-        interval += (last_start_time - contraction.start_time);
-      }
-      last_start_time = contraction.start_time;
-    } else {
-      break;
+  // The phone has the transaction, so it is told how each record went back
+  apply_undo_log();
+  number_of_logged_undo_entries = 0;
+  log_staged_changes(number_of_undo_entries);
+  number_of_undo_entries = 0;
+  flush_contractions();
+  data_changed();
+  return true;
+}
+
+uint32_t store_data_version() {
+  return data_version;
+}
+
+bool store_subscribe(StoreChangedHandler handler) {
+  for (int i = 0; i < MAX_NUMBER_OF_SUBSCRIBERS; i++) {
+    if (subscribers[i] == NULL || subscribers[i] == handler) {
+      subscribers[i] = handler;
+      return true;
     }
   }
 
-  result.average_duration_in_seconds = duration / result.count;
-  if (result.count > 1) {
-    result.average_interval_in_seconds = interval / (result.count - 1);
-  } else {
-    result.average_interval_in_seconds = interval;
+  APP_LOG(APP_LOG_LEVEL_WARNING, "No room for another store subscriber, raise MAX_NUMBER_OF_SUBSCRIBERS");
+  return false;
+}
+
+void store_unsubscribe(StoreChangedHandler handler) {
+  for (int i = 0; i < MAX_NUMBER_OF_SUBSCRIBERS; i++) {
+    if (subscribers[i] == handler) {
+      subscribers[i] = NULL;
+    }
   }
+}
 
-  return result;
+SummaryTotals store_calculate_summary_totals(int minutes) {
+  const time_t current_time = time(NULL);
+  const time_t time_cutoff = current_time - 60 * minutes;
+
+  // Only the current (latest) session can fall inside the window
+  refresh_dates();
+  int count = number_of_sessions > 0 ? sessions[0].session.count : 0;
+
+  return summary_totals_since(start_times, durations, count, time_cutoff);
+}
+
+SummaryResult store_summary_for_totals(const SummaryTotals *totals) {
+  return summary_result_for_totals(totals);
+}
+
+SummaryResult store_project_summary(const SummaryTotals *totals, time_t start_time, int seconds_elapsed) {
+  return summary_project(totals, start_time, seconds_elapsed);
+}
+
+SummaryResult store_calculate_summary(int minutes) {
+  SummaryTotals totals = store_calculate_summary_totals(minutes);
+  return store_summary_for_totals(&totals);
 }
 
 bool store_should_show_disclaimer() {
-  return persist_exists(DISCLAIMER_SHOWN_KEY) ? !persist_read_bool(DISCLAIMER_SHOWN_KEY) : true;
+  return value_exists(DISCLAIMER_SHOWN_KEY) ? !read_bool(DISCLAIMER_SHOWN_KEY) : true;
 }
 
 void store_set_disclaimer_shown(bool shown) {
-  persist_write_bool(DISCLAIMER_SHOWN_KEY, shown);
+  write_bool(DISCLAIMER_SHOWN_KEY, shown);
+}
+
+void store_set_storage(const StorageBackend *backend) {
+  storage = backend;
 }
 
 void store_init() {
-  if (persist_exists(CONTRACTIONS_KEY)) {
-    status_t status = persist_read_data(CONTRACTIONS_KEY, contraction_keys, sizeof(contraction_keys));
-    if (status == sizeof(contraction_keys)) {
-      cleanup_contractions();
-      sort_contractions();
-      rebuild_dates();
+  number_of_archived_days = 0;
+  if (value_exists(ARCHIVE_KEY)) {
+    status_t status = read_value(ARCHIVE_KEY, archived_days, sizeof(archived_days));
+    if (status > 0) {
+      number_of_archived_days = status / sizeof(DailyAggregate);
     }
   }
+
+  if (value_exists(SCHEMA_VERSION_KEY)) {
+    schema_version = read_int(SCHEMA_VERSION_KEY);
+  } else if (value_exists(CONTRACTIONS_KEY)) {
+    schema_version = 1;
+  } else {
+    // Fresh install
+    schema_version = SCHEMA_VERSION;
+    write_int(SCHEMA_VERSION_KEY, schema_version);
+  }
+
+  // Records already converted by an interrupted migration are kept
+  load_contractions();
+  load_change_log();
+  flush_contractions();
+
+  if (schema_version < SCHEMA_VERSION) {
+    migration_progress = value_exists(MIGRATION_PROGRESS_KEY) ? read_int(MIGRATION_PROGRESS_KEY) : 0;
+    migration_timer = app_timer_register(MIGRATION_CHUNK_DELAY, migration_timer_callback, NULL);
+  } else {
+    archive_old_contractions(false);
+    flush_contractions();
+  }
+
+  data_changed();
 }
 
 void store_deinit() {
-  sort_contractions();
-  persist_write_data(CONTRACTIONS_KEY, contraction_keys, sizeof(contraction_keys));
+  if (migration_timer != NULL) {
+    // Progress is persisted after every chunk, so the next launch resumes
+    app_timer_cancel(migration_timer);
+    migration_timer = NULL;
+  }
+
+  flush_contractions();
 }
\ No newline at end of file
@@ -1,5 +1,14 @@
 #include <pebble.h>
 #pragma once
+#include "summary_math.h"
+#include "storage.h"
+
+// Records kept in full detail before the oldest days are archived; set in
+// wscript, and checked against the persist and RAM budgets in store.c
+#ifndef MAX_NUMBER_OF_CONTRACTIONS
+#define MAX_NUMBER_OF_CONTRACTIONS 64
+#endif
+#define MAX_NUMBER_OF_SESSIONS 16
 
 typedef struct {
   time_t start_time;
@@ -7,13 +16,47 @@ typedef struct {
 } Contraction;
 
 typedef struct {
+  time_t start_time;
+  time_t end_time;
   int count;
-  int average_duration_in_seconds;
-  int average_interval_in_seconds;
-} SummaryResult;
+  int total_duration_in_seconds;
+  int total_interval_in_seconds;
+} Session;
+
+// Compact roll-up of one day of contractions that aged out of full detail
+typedef struct {
+  time_t start_time;
+  time_t end_time;
+  uint16_t count;
+  uint16_t min_duration_in_seconds;
+  uint16_t max_duration_in_seconds;
+  // Of the day's newest record, so its start is end_time less this. It
+  // fills what was padding, so days archived before it read as 0.
+  uint16_t newest_duration_in_seconds;
+  uint32_t total_duration_in_seconds;
+  uint32_t total_interval_in_seconds;
+} DailyAggregate;
+
+typedef enum {
+  ChangePut,
+  ChangeRemove,
+  ChangeRemoveAll
+} ChangeKind;
+
+// One entry of the log of changes not yet synced to the phone
+typedef struct {
+  uint32_t sequence;
+  uint32_t start_time;
+  uint16_t seconds_elapsed;
+  uint8_t kind;
+} Change;
+
+// Called with the new data version after every change to the store
+typedef void (*StoreChangedHandler)(uint32_t data_version);
 
 void store_time_for_hour_minute(char *buffer, size_t size, int hour, int minute);
 void store_time_for_time(char *buffer, size_t size, int hour, int minute, int second);
+void store_time_for_seconds_into_day(char *buffer, size_t size, int seconds);
 void store_date_for_month_day(char *buffer, size_t size, int month, int day);
 void store_time_text_for_contraction(char *start_time_buffer, size_t start_time_size, char *end_time_buffer, size_t end_time_size, int contraction_key);
 void store_duration_for_seconds_elapsed(char *buffer, size_t size, int seconds_elapsed);
@@ -23,8 +66,22 @@ int store_number_of_past_contractions();
 int store_number_of_date_sections();
 void store_date_for_date_section(char *date_as_string, size_t num, int date_section);
 
+int store_session_for_date_section(int date_section);
+int store_first_date_section_for_session(int session);
+int store_number_of_date_sections_for_session(int session);
+
+int store_number_of_sessions();
+bool store_session(int session, Session *result);
+
+int store_number_of_archived_days();
+bool store_archived_day(int archived_day, DailyAggregate *result);
+// Records that end by this time were rolled up into the archived days; 0
+// while none are
+time_t store_archive_cutoff();
+
 int store_number_of_contractions_for_date_section(int date_section);
 int store_contraction_for_date_section_index(int date_section, int contraction_index, Contraction *contraction);
+bool store_contraction_at_index(int index, Contraction *contraction);
 uint32_t store_contraction_key(int date_section, int contraction_index);
 status_t store_contraction_for_key(uint32_t contraction_key, Contraction *contraction);
 status_t store_contractions_for_key(
@@ -38,10 +95,45 @@ uint32_t store_replace_contraction(uint32_t old_contraction_key, time_t new_star
 void store_remove_contraction(time_t start_time);
 void store_remove_all_contractions();
 
+// Changes between begin and commit are staged in RAM and written together;
+// abort drops them. Every change outside a transaction commits on its own.
+// Only a commit logs changes for sync, and undo reverses the last commit.
+void store_begin_transaction();
+void store_commit_transaction();
+void store_abort_transaction();
+bool store_can_undo();
+bool store_undo_last_transaction();
+
+// Every change gets the next sequence number. A phone that has applied
+// everything up to a sequence can catch up from the change log unless that
+// part of the log was dropped for room.
+uint32_t store_sync_sequence();
+bool store_can_sync_from(uint32_t sequence);
+bool store_next_change(uint32_t after_sequence, Change *change);
+void store_acknowledge_changes(uint32_t sequence);
+
+// Loads records in bulk, newest first for speed. Nothing is written and no
+// subscriber is told until the import ends.
+bool store_begin_import();
+void store_import_contraction(time_t start_time, int seconds_elapsed);
+void store_end_import();
+
+uint32_t store_data_version();
+// False, and nothing is called, once every subscriber slot is taken
+bool store_subscribe(StoreChangedHandler handler);
+void store_unsubscribe(StoreChangedHandler handler);
+
 SummaryResult store_calculate_summary(int minutes);
+SummaryTotals store_calculate_summary_totals(int minutes);
+SummaryResult store_summary_for_totals(const SummaryTotals *totals);
+SummaryResult store_project_summary(const SummaryTotals *totals, time_t start_time, int seconds_elapsed);
 
 bool store_should_show_disclaimer();
 void store_set_disclaimer_shown(bool shown);
 
+// Where the store keeps its data; only takes effect before init. The
+// default is Pebble persist.
+void store_set_storage(const StorageBackend *backend);
+
 void store_init();
 void store_deinit();
\ No newline at end of file
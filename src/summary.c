@@ -1,6 +1,7 @@
 #include <pebble.h>
 #include "store.h"
 #include "new_contraction.h"
+#include "chart.h"
 
 static Window *window;
 
@@ -33,9 +34,16 @@ static char average_interval_title[] = "AVERAGE\nINTERVAL";
 
 static int range_in_minutes = 60;
 
+// What the text layers currently show; the summary only moves when the data
+// changes or a new minute slides the window
+static uint32_t rendered_data_version;
+static time_t rendered_minute;
+
 // Click handlers
 static void update_text_layer_titles() {
   SummaryResult result = store_calculate_summary(range_in_minutes);
+  rendered_data_version = store_data_version();
+  rendered_minute = time(NULL) / 60;
 
   int count = result.count;
   if (count == 1) {
@@ -57,10 +65,20 @@ static void update_text_layer_titles() {
   text_layer_set_text(average_interval_layer, average_interval_text);
 }
 
+static void update_text_layer_titles_if_changed() {
+  if (rendered_data_version != store_data_version() || rendered_minute != time(NULL) / 60) {
+    update_text_layer_titles();
+  }
+}
+
 static void show_new_contraction_handler(ClickRecognizerRef recognizer, void *context) {
   show_new_contraction();
 }
 
+static void show_chart_handler(ClickRecognizerRef recognizer, void *context) {
+  show_chart();
+}
+
 static void show_60_mins_handler(ClickRecognizerRef recognizer, void *context) {
   text_layer_set_text(title_layer, title_1_hour_text);
   range_in_minutes = 60;
@@ -77,6 +95,15 @@ static void click_config_provider(void *context) {
   window_single_click_subscribe(BUTTON_ID_UP, (ClickHandler)show_new_contraction_handler);
   window_single_click_subscribe(BUTTON_ID_SELECT, (ClickHandler)show_60_mins_handler);
   window_single_click_subscribe(BUTTON_ID_DOWN, (ClickHandler)show_30_mins_handler);
+  // Holding select opens the chart of the last few hours
+  window_long_click_subscribe(BUTTON_ID_SELECT, 0, (ClickHandler)show_chart_handler, NULL);
+}
+
+// Store callbacks
+static void store_changed_handler(uint32_t data_version) {
+  if (window_stack_get_top_window() == window) {
+    update_text_layer_titles();
+  }
 }
 
 // Layer callbacks
@@ -164,14 +191,17 @@ static void window_load(Window *window) {
   layer_add_child(window_layer, text_layer_get_layer(average_interval_title_layer));
 
   update_text_layer_titles();
+  store_subscribe(store_changed_handler);
 }
 
 
 static void window_appear(Window *window) {
-  update_text_layer_titles();
+  update_text_layer_titles_if_changed();
 }
 
 static void window_unload(Window *window) {
+  store_unsubscribe(store_changed_handler);
+
   text_layer_destroy(title_layer);
   layer_destroy(line_layer);
   text_layer_destroy(total_layer);
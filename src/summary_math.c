@@ -0,0 +1,98 @@
+#include "summary_math.h"
+
+// Column kernels. Scans walk a single contiguous column rather than
+// gathering whole records.
+
+// Number of records whose start time is at or after the cutoff; start times
+// are sorted newest first, so this is a bisection
+int summary_count_starting_since(const uint32_t *start_times, int count, time_t time_cutoff) {
+  const uint32_t cutoff = time_cutoff < 0 ? 0 : time_cutoff;
+  int low = 0;
+  int high = count;
+
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (start_times[middle] >= cutoff) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+int summary_sum_durations(const uint16_t *durations, int count) {
+  int total = 0;
+  for (int i = 0; i < count; i++) {
+    total += durations[i];
+  }
+  return total;
+}
+
+// Intervals between consecutive records telescope to the span between the
+// newest and oldest start
+int summary_total_interval(const uint32_t *start_times, int count) {
+  return count > 1 ? (int)(start_times[0] - start_times[count - 1]) : 0;
+}
+
+// The gap runs from the older contraction's end to the newer one's start;
+// records that overlap have none
+bool summary_is_session_gap(uint32_t newer_start_time, uint32_t older_start_time, uint16_t older_duration) {
+  const uint32_t older_end_time = older_start_time + older_duration;
+  return newer_start_time > older_end_time && newer_start_time - older_end_time > SESSION_GAP_IN_SECONDS;
+}
+
+int summary_newest_session_length(const uint32_t *start_times, const uint16_t *durations, int count) {
+  for (int i = 1; i < count; i++) {
+    if (summary_is_session_gap(start_times[i - 1], start_times[i], durations[i])) {
+      return i;
+    }
+  }
+  return count;
+}
+
+SummaryTotals summary_totals_since(const uint32_t *start_times, const uint16_t *durations, int count, time_t time_cutoff) {
+  SummaryTotals totals = { 0 };
+
+  totals.count = summary_count_starting_since(start_times, count, time_cutoff);
+  if (totals.count > 0) {
+    totals.newest_start_time = start_times[0];
+    totals.oldest_start_time = start_times[totals.count - 1];
+    totals.total_duration_in_seconds = summary_sum_durations(durations, totals.count);
+  }
+
+  return totals;
+}
+
+SummaryResult summary_result_for_totals(const SummaryTotals *totals) {
+  SummaryResult result = { 0 };
+  result.count = totals->count;
+
+  int interval = totals->newest_start_time - totals->oldest_start_time;
+
+  if (result.count > 0) {
+    result.average_duration_in_seconds = totals->total_duration_in_seconds / result.count;
+  }
+  if (result.count > 1) {
+    result.average_interval_in_seconds = interval / (result.count - 1);
+  } else {
+    result.average_interval_in_seconds = interval;
+  }
+
+  return result;
+}
+
+SummaryResult summary_project(const SummaryTotals *totals, time_t start_time, int seconds_elapsed) {
+  // Folding one more record in only touches the count, the duration total
+  // and the newest start, so this costs the same for any history size
+  SummaryTotals projected = *totals;
+  projected.count++;
+  projected.total_duration_in_seconds += seconds_elapsed;
+  projected.newest_start_time = start_time;
+  if (totals->count == 0) {
+    projected.oldest_start_time = start_time;
+  }
+
+  return summary_result_for_totals(&projected);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Summary math over the start time and duration columns, kept free of the
+// Pebble SDK so host tools can share it with the watch
+
+// A new session starts after a gap this long between contractions
+#define SESSION_GAP_IN_SECONDS (6 * 60 * 60)
+
+typedef struct {
+  int count;
+  int average_duration_in_seconds;
+  int average_interval_in_seconds;
+} SummaryResult;
+
+// Running sums behind a SummaryResult; averages are derived from them on
+// demand so more records can be folded in without rescanning
+typedef struct {
+  int count;
+  int total_duration_in_seconds;
+  time_t newest_start_time;
+  time_t oldest_start_time;
+} SummaryTotals;
+
+// Columns are sorted newest first
+int summary_count_starting_since(const uint32_t *start_times, int count, time_t time_cutoff);
+int summary_sum_durations(const uint16_t *durations, int count);
+int summary_total_interval(const uint32_t *start_times, int count);
+bool summary_is_session_gap(uint32_t newer_start_time, uint32_t older_start_time, uint16_t older_duration);
+int summary_newest_session_length(const uint32_t *start_times, const uint16_t *durations, int count);
+
+SummaryTotals summary_totals_since(const uint32_t *start_times, const uint16_t *durations, int count, time_t time_cutoff);
+SummaryResult summary_result_for_totals(const SummaryTotals *totals);
+SummaryResult summary_project(const SummaryTotals *totals, time_t start_time, int seconds_elapsed);
\ No newline at end of file
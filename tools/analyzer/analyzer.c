@@ -0,0 +1,421 @@
+// Batch analyzer for contraction logs exported from the watch.
+//
+//   analyzer [-j threads] [-m minutes] [-t now] log...
+//
+// Each log is either a log file (see src/log_format.h), which is mapped and
+// scanned in place, or the records packed as the watch exports them. Logs
+// are spread over a pool of worker threads that steal from each other when
+// they run dry; each worker keeps its own fleet totals, merged once at the
+// end. Prints a line per log in the order given, then the fleet-wide figures.
+//
+// The window summary is store_calculate_summary's: records of the newest
+// session that started in the last so many minutes, as of -t or else the
+// end of the newest record.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log_file.h"
+#include "log_format.h"
+#include "summary_math.h"
+
+#define RECORD_SIZE LOG_RECORD_SIZE
+#define DEFAULT_SUMMARY_MINUTES 60
+#define MAX_NUMBER_OF_WORKERS 256
+
+typedef struct {
+  int count;
+  int number_of_sessions;
+  long total_duration_in_seconds;
+  long total_interval_in_seconds;
+  SummaryResult window;
+  int error;
+} LogResult;
+
+typedef struct {
+  long number_of_logs;
+  long number_of_failed_logs;
+  long count;
+  long number_of_sessions;
+  long total_duration_in_seconds;
+  long total_interval_in_seconds;
+  long window_count;
+  long number_of_bytes;
+} FleetTotals;
+
+// Logs next..end-1 are left to do. The owner takes from the front and
+// thieves take the back half.
+typedef struct {
+  pthread_mutex_t lock;
+  int next;
+  int end;
+} WorkQueue;
+
+typedef struct {
+  pthread_t thread;
+  WorkQueue queue;
+  FleetTotals totals;
+
+  // Reused from log to log
+  uint8_t *bytes;
+  size_t bytes_size;
+  uint32_t *start_times;
+  uint16_t *durations;
+  int columns_size;
+} Worker;
+
+static char **log_paths;
+static LogResult *results;
+static Worker *workers;
+static int number_of_workers;
+static int summary_minutes = DEFAULT_SUMMARY_MINUTES;
+static time_t summary_time;
+
+// Static functions
+static int read_log(Worker *worker, const char *path, size_t *size) {
+  *size = 0;
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return errno;
+  }
+
+  for (;;) {
+    if (*size == worker->bytes_size) {
+      worker->bytes_size = worker->bytes_size > 0 ? worker->bytes_size * 2 : 4096;
+      worker->bytes = realloc(worker->bytes, worker->bytes_size);
+    }
+    size_t read = fread(worker->bytes + *size, 1, worker->bytes_size - *size, file);
+    if (read == 0) {
+      break;
+    }
+    *size += read;
+  }
+
+  int error = ferror(file) ? EIO : 0;
+  fclose(file);
+  return error;
+}
+
+static int compare_newest_first(const void *a, const void *b) {
+  const uint8_t *record_a = a;
+  const uint8_t *record_b = b;
+  uint32_t start_a = log_read_uint32(record_a);
+  uint32_t start_b = log_read_uint32(record_b);
+  return start_a < start_b ? 1 : start_a > start_b ? -1 : 0;
+}
+
+// Unpack into the columns the summary math works on, newest first
+static void reserve_columns(Worker *worker, int count) {
+  if (count > worker->columns_size) {
+    worker->columns_size = count;
+    worker->start_times = realloc(worker->start_times, count * sizeof(uint32_t));
+    worker->durations = realloc(worker->durations, count * sizeof(uint16_t));
+  }
+}
+
+static int load_columns(Worker *worker, size_t size) {
+  int count = size / RECORD_SIZE;
+  reserve_columns(worker, count);
+
+  bool is_sorted = true;
+  for (int pass = 0; pass < 2; pass++) {
+    const uint8_t *bytes = worker->bytes;
+    for (int i = 0; i < count; i++, bytes += RECORD_SIZE) {
+      log_unpack_record(bytes, &worker->start_times[i], &worker->durations[i]);
+      if (i > 0 && worker->start_times[i] > worker->start_times[i - 1]) {
+        is_sorted = false;
+      }
+    }
+    if (is_sorted) {
+      break;
+    }
+    qsort(worker->bytes, count, RECORD_SIZE, compare_newest_first);
+    is_sorted = true;
+  }
+
+  return count;
+}
+
+static void summarize_window(LogResult *result, const uint32_t *start_times, const uint16_t *durations, int session_length) {
+  if (session_length > 0) {
+    time_t now = summary_time != 0 ? summary_time : (time_t)start_times[0] + durations[0];
+    SummaryTotals totals = summary_totals_since(start_times, durations, session_length, now - 60 * summary_minutes);
+    result->window = summary_result_for_totals(&totals);
+  }
+}
+
+static void analyze_records(Worker *worker, LogResult *result, int count) {
+  const uint32_t *start_times = worker->start_times;
+  const uint16_t *durations = worker->durations;
+
+  result->count = count;
+  result->total_duration_in_seconds = summary_sum_durations(durations, count);
+
+  // Intervals are only counted within a session
+  for (int first = 0; first < count;) {
+    int length = summary_newest_session_length(&start_times[first], &durations[first], count - first);
+    result->number_of_sessions++;
+    result->total_interval_in_seconds += summary_total_interval(&start_times[first], length);
+    first += length;
+  }
+
+  summarize_window(result, start_times, durations, summary_newest_session_length(start_times, durations, count));
+}
+
+// The session table already holds the totals; only the window touches the
+// columns, and only the part of them inside it
+static void analyze_log_file(Worker *worker, LogResult *result, const LogFile *file) {
+  LogSession newest_session = { 0 };
+  for (uint32_t i = 0; i < file->number_of_sessions; i++) {
+    LogSession session;
+    log_file_session(file, i, &session);
+    result->total_duration_in_seconds += session.total_duration_in_seconds;
+    result->total_interval_in_seconds += session.total_interval_in_seconds;
+    if (i == 0) {
+      newest_session = session;
+    }
+  }
+  result->count = file->count;
+  result->number_of_sessions = file->number_of_sessions;
+
+  if (file->start_times != NULL) {
+    summarize_window(result, file->start_times, file->durations, newest_session.count);
+    return;
+  }
+
+  reserve_columns(worker, newest_session.count);
+  for (uint32_t i = 0; i < newest_session.count; i++) {
+    worker->start_times[i] = log_file_start_time(file, i);
+    worker->durations[i] = log_file_duration(file, i);
+  }
+  summarize_window(result, worker->start_times, worker->durations, newest_session.count);
+}
+
+static void analyze_log(Worker *worker, int index) {
+  LogResult *result = &results[index];
+  size_t size = 0;
+  worker->totals.number_of_logs++;
+
+  LogFile file;
+  result->error = log_file_map(&file, log_paths[index]);
+  if (result->error == 0) {
+    size = file.size;
+    analyze_log_file(worker, result, &file);
+    log_file_unmap(&file);
+  } else if (result->error == EINVAL) {
+    // Not a log file, so a plain run of records unless it claims otherwise
+    result->error = read_log(worker, log_paths[index], &size);
+    if (result->error == 0 && log_file_is_log(worker->bytes, size)) {
+      result->error = EINVAL;
+    }
+    if (result->error == 0) {
+      analyze_records(worker, result, load_columns(worker, size));
+    }
+  }
+
+  if (result->error != 0) {
+    worker->totals.number_of_failed_logs++;
+    return;
+  }
+
+  FleetTotals *totals = &worker->totals;
+  totals->count += result->count;
+  totals->number_of_sessions += result->number_of_sessions;
+  totals->total_duration_in_seconds += result->total_duration_in_seconds;
+  totals->total_interval_in_seconds += result->total_interval_in_seconds;
+  totals->window_count += result->window.count;
+  totals->number_of_bytes += size;
+}
+
+static int remaining_work(WorkQueue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  int remaining = queue->end - queue->next;
+  pthread_mutex_unlock(&queue->lock);
+  return remaining;
+}
+
+static bool take_work(WorkQueue *queue, int *index) {
+  pthread_mutex_lock(&queue->lock);
+  bool found = queue->next < queue->end;
+  if (found) {
+    *index = queue->next++;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return found;
+}
+
+// Move the back half of the fullest other queue into this worker's own
+static bool steal_work(Worker *thief) {
+  for (;;) {
+    Worker *victim = NULL;
+    int most = 1;
+    for (int i = 0; i < number_of_workers; i++) {
+      int remaining = &workers[i] != thief ? remaining_work(&workers[i].queue) : 0;
+      if (remaining > most) {
+        victim = &workers[i];
+        most = remaining;
+      }
+    }
+    if (victim == NULL) {
+      // Nothing worth splitting; a last single log is taken whole
+      for (int i = 0; i < number_of_workers; i++) {
+        int index;
+        if (&workers[i] != thief && take_work(&workers[i].queue, &index)) {
+          pthread_mutex_lock(&thief->queue.lock);
+          thief->queue.next = index;
+          thief->queue.end = index + 1;
+          pthread_mutex_unlock(&thief->queue.lock);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    pthread_mutex_lock(&victim->queue.lock);
+    int remaining = victim->queue.end - victim->queue.next;
+    int stolen_end = victim->queue.end;
+    if (remaining > 1) {
+      victim->queue.end -= remaining / 2;
+    }
+    int stolen_next = victim->queue.end;
+    pthread_mutex_unlock(&victim->queue.lock);
+
+    if (stolen_next < stolen_end) {
+      pthread_mutex_lock(&thief->queue.lock);
+      thief->queue.next = stolen_next;
+      thief->queue.end = stolen_end;
+      pthread_mutex_unlock(&thief->queue.lock);
+      return true;
+    }
+  }
+}
+
+static void *worker_main(void *data) {
+  Worker *worker = data;
+  int index;
+
+  do {
+    while (take_work(&worker->queue, &index)) {
+      analyze_log(worker, index);
+    }
+  } while (steal_work(worker));
+
+  return NULL;
+}
+
+static void merge_totals(FleetTotals *fleet, const FleetTotals *totals) {
+  fleet->number_of_logs += totals->number_of_logs;
+  fleet->number_of_failed_logs += totals->number_of_failed_logs;
+  fleet->count += totals->count;
+  fleet->number_of_sessions += totals->number_of_sessions;
+  fleet->total_duration_in_seconds += totals->total_duration_in_seconds;
+  fleet->total_interval_in_seconds += totals->total_interval_in_seconds;
+  fleet->window_count += totals->window_count;
+  fleet->number_of_bytes += totals->number_of_bytes;
+}
+
+static double elapsed_seconds(const struct timespec *since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+static void print_usage(const char *name) {
+  fprintf(stderr, "usage: %s [-j threads] [-m minutes] [-t now] log...\n", name);
+}
+
+// Non-static functions
+int main(int argc, char **argv) {
+  long number_of_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  number_of_workers = number_of_cores > 0 ? number_of_cores : 1;
+
+  int option;
+  while ((option = getopt(argc, argv, "j:m:t:")) != -1) {
+    switch (option) {
+      case 'j':
+        number_of_workers = atoi(optarg);
+        break;
+      case 'm':
+        summary_minutes = atoi(optarg);
+        break;
+      case 't':
+        summary_time = strtol(optarg, NULL, 10);
+        break;
+      default:
+        print_usage(argv[0]);
+        return 2;
+    }
+  }
+
+  int number_of_logs = argc - optind;
+  if (number_of_logs == 0 || number_of_workers < 1 || summary_minutes < 1) {
+    print_usage(argv[0]);
+    return 2;
+  }
+  if (number_of_workers > MAX_NUMBER_OF_WORKERS) {
+    number_of_workers = MAX_NUMBER_OF_WORKERS;
+  }
+  if (number_of_workers > number_of_logs) {
+    number_of_workers = number_of_logs;
+  }
+
+  log_paths = &argv[optind];
+  results = calloc(number_of_logs, sizeof(LogResult));
+  workers = calloc(number_of_workers, sizeof(Worker));
+
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  // Contiguous shares to start with; stealing evens out uneven logs
+  for (int i = 0; i < number_of_workers; i++) {
+    pthread_mutex_init(&workers[i].queue.lock, NULL);
+    workers[i].queue.next = (long)number_of_logs * i / number_of_workers;
+    workers[i].queue.end = (long)number_of_logs * (i + 1) / number_of_workers;
+  }
+  for (int i = 0; i < number_of_workers; i++) {
+    pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+  }
+
+  FleetTotals fleet = { 0 };
+  for (int i = 0; i < number_of_workers; i++) {
+    pthread_join(workers[i].thread, NULL);
+    merge_totals(&fleet, &workers[i].totals);
+    free(workers[i].bytes);
+    free(workers[i].start_times);
+    free(workers[i].durations);
+  }
+  double seconds = elapsed_seconds(&start_time);
+
+  printf("log\tcount\tsessions\tavg_duration\tavg_interval\twindow_count\twindow_avg_duration\twindow_avg_interval\n");
+  for (int i = 0; i < number_of_logs; i++) {
+    const LogResult *result = &results[i];
+    if (result->error != 0) {
+      fprintf(stderr, "%s: %s\n", log_paths[i], strerror(result->error));
+      continue;
+    }
+
+    int intervals = result->count - result->number_of_sessions;
+    printf("%s\t%d\t%d\t%ld\t%ld\t%d\t%d\t%d\n", log_paths[i], result->count, result->number_of_sessions,
+      result->count > 0 ? result->total_duration_in_seconds / result->count : 0,
+      intervals > 0 ? result->total_interval_in_seconds / intervals : 0,
+      result->window.count, result->window.average_duration_in_seconds, result->window.average_interval_in_seconds);
+  }
+
+  long intervals = fleet.count - fleet.number_of_sessions;
+  printf("fleet\tlogs=%ld\tfailed=%ld\tcount=%ld\tsessions=%ld\tavg_duration=%ld\tavg_interval=%ld\twindow_count=%ld\n",
+    fleet.number_of_logs, fleet.number_of_failed_logs, fleet.count, fleet.number_of_sessions,
+    fleet.count > 0 ? fleet.total_duration_in_seconds / fleet.count : 0,
+    intervals > 0 ? fleet.total_interval_in_seconds / intervals : 0,
+    fleet.window_count);
+  fprintf(stderr, "%d logs, %.1f MB with %d threads in %.3f s (%.0f logs/s)\n",
+    number_of_logs, fleet.number_of_bytes / 1e6, number_of_workers, seconds, number_of_logs / seconds);
+
+  free(results);
+  free(workers);
+  return fleet.number_of_failed_logs > 0 ? 1 : 0;
+}
\ No newline at end of file
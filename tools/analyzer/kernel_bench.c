@@ -0,0 +1,90 @@
+// Times the summary kernels the watch runs over its record columns, at the
+// watch's default capacity and at the sizes a bigger build or a host log
+// would have.
+//
+//   kernel_bench
+//
+// Prints a line per column size with the time per call of the summary over
+// the last hour, the interval total over every record and the session split.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "summary_math.h"
+
+#define FIRST_START_TIME 1400000000
+#define MAX_NUMBER_OF_RECORDS 10000
+// Calls timed at each size add up to about this many records scanned
+#define RECORDS_PER_KERNEL 50000000
+
+static uint32_t start_times[MAX_NUMBER_OF_RECORDS];
+static uint16_t durations[MAX_NUMBER_OF_RECORDS];
+static const int column_sizes[] = { 64, 1000, 10000 };
+
+// Keeps the results alive so the calls are not optimized away
+static volatile long sink;
+
+// Static functions
+// Newest first, a contraction every few minutes and a gap of a day after
+// every 40, so there are sessions to split
+static void make_columns() {
+  uint32_t start_time = FIRST_START_TIME;
+  for (int i = 0; i < MAX_NUMBER_OF_RECORDS; i++) {
+    start_times[i] = start_time;
+    durations[i] = 30 + i % 60;
+    start_time -= i % 40 == 39 ? 24 * 60 * 60 : 3 * 60 + i % 120;
+  }
+}
+
+static double elapsed_ns(const struct timespec *since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) * 1e9 + (now.tv_nsec - since->tv_nsec);
+}
+
+static double time_summary(int count, int calls) {
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  for (int i = 0; i < calls; i++) {
+    SummaryTotals totals = summary_totals_since(start_times, durations, count, (time_t)FIRST_START_TIME - 60 * 60 - i % 2);
+    sink += totals.count;
+  }
+  return elapsed_ns(&start_time) / calls;
+}
+
+static double time_total_interval(int count, int calls) {
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  for (int i = 0; i < calls; i++) {
+    sink += summary_total_interval(start_times, count - i % 2);
+  }
+  return elapsed_ns(&start_time) / calls;
+}
+
+// As rebuild_sessions and the analyzer walk the columns
+static double time_session_split(int count, int calls) {
+  struct timespec start_time;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  for (int i = 0; i < calls; i++) {
+    int number_of_sessions = 0;
+    for (int first = 0; first < count;) {
+      first += summary_newest_session_length(&start_times[first], &durations[first], count - first);
+      number_of_sessions++;
+    }
+    sink += number_of_sessions;
+  }
+  return elapsed_ns(&start_time) / calls;
+}
+
+// Non-static functions
+int main() {
+  make_columns();
+
+  printf("records\tsummary_ns\tinterval_ns\tsessions_ns\n");
+  for (size_t i = 0; i < sizeof(column_sizes) / sizeof(column_sizes[0]); i++) {
+    int count = column_sizes[i];
+    int calls = RECORDS_PER_KERNEL / count;
+    printf("%d\t%.1f\t%.1f\t%.1f\n", count, time_summary(count, calls), time_total_interval(count, calls), time_session_split(count, calls));
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Writes logs for "make check" to compare the analyzer's threads against.
+//
+//   make_logs dir count
+//
+// Sizes are uneven, a few logs being far bigger than the rest, so workers
+// run dry at different times and steal. Every other log is a log file; the
+// rest are records as the watch exports them, some out of order. The same
+// arguments always give the same logs.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "log_file.h"
+#include "log_format.h"
+
+#define FIRST_START_TIME 1400000000
+#define MAX_NUMBER_OF_RECORDS 20000
+
+static uint32_t start_times[MAX_NUMBER_OF_RECORDS];
+static uint16_t durations[MAX_NUMBER_OF_RECORDS];
+static uint32_t random_state = 1;
+
+// Static functions
+static uint32_t next_random(uint32_t limit) {
+  random_state = random_state * 1103515245 + 12345;
+  return (random_state >> 8) % limit;
+}
+
+// Newest first, in sessions split by gaps of hours
+static int make_records() {
+  int count = next_random(10) == 0 ? 2000 + next_random(MAX_NUMBER_OF_RECORDS - 2000) : next_random(300);
+  uint32_t start_time = FIRST_START_TIME + next_random(30 * 24 * 60 * 60);
+  for (int i = 0; i < count; i++) {
+    durations[i] = 20 + next_random(70);
+    start_times[i] = start_time;
+    start_time -= next_random(20) == 0 ? 3 * 60 * 60 + next_random(24 * 60 * 60) : durations[i] + 60 + next_random(15 * 60);
+  }
+  return count;
+}
+
+static int write_records(const char *path, int count) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  // Swap a few neighbours so the analyzer has to sort
+  for (int i = 0; i < count; i++) {
+    uint8_t bytes[2 * LOG_RECORD_SIZE];
+    if (i + 1 < count && next_random(50) == 0) {
+      log_pack_record(log_pack_record(bytes, start_times[i + 1], durations[i + 1]), start_times[i], durations[i]);
+      fwrite(bytes, 1, sizeof(bytes), file);
+      i++;
+    } else {
+      log_pack_record(bytes, start_times[i], durations[i]);
+      fwrite(bytes, 1, LOG_RECORD_SIZE, file);
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+// Non-static functions
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s dir count\n", argv[0]);
+    return 2;
+  }
+
+  int number_of_logs = atoi(argv[2]);
+  for (int i = 0; i < number_of_logs; i++) {
+    char path[1024];
+    int count = make_records();
+    if (i % 2 == 0) {
+      snprintf(path, sizeof(path), "%s/%04d.log", argv[1], i);
+      if (log_file_write(path, start_times, durations, count, i) != 0) {
+        perror(path);
+        return 1;
+      }
+    } else {
+      snprintf(path, sizeof(path), "%s/%04d.records", argv[1], i);
+      if (write_records(path, count) != 0) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
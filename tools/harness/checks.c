@@ -0,0 +1,1021 @@
+#include <unistd.h>
+#include "harness.h"
+#include "calendar.h"
+#include "export.h"
+#include "file_storage.h"
+#include "log_format.h"
+#include "store.h"
+#include "summary_math.h"
+
+// Checks of the store, each from an empty watch and run once on every
+// storage backend: the persist stand-in, the app heap, and files in a
+// directory of their own. "make check" runs them and fails if any does;
+// every check prints one line, and every failed expectation the line it is
+// on.
+
+#define DEFAULT_START_TIME 1400000000
+#define HOUR (60 * 60)
+
+// Version 1 layout, as the store's migration reads it: an index of record
+// keys, and each record under its start time as decimal MMDDHHMMSS
+#define VERSION_1_INDEX_KEY 0
+#define VERSION_1_MAX_NUMBER_OF_CONTRACTIONS 64
+
+// The store's own keys are all below this: a few fixed ones, then a page
+// from key 16 on for every few records
+#define MAX_STORE_KEY (16 + MAX_NUMBER_OF_CONTRACTIONS)
+
+// The phone's side of the sync follows src/js/pebble-js-app.js. Message
+// keys as listed under appKeys in appinfo.json.
+#define MAX_NUMBER_OF_PHONE_RECORDS 512
+#define MAX_NUMBER_OF_PENDING_CHANGES 256
+#define MAX_NUMBER_OF_PHONE_MESSAGES 32
+#define IMPORT_RECORDS_PER_CHUNK 36
+#define IMPORT_RETRY_DELAY 2000
+#define MAX_IMPORT_ATTEMPTS 10
+
+typedef enum {
+  ExportCountKey = 0,
+  ExportOffsetKey = 1,
+  ExportRecordsKey = 2,
+  ExportDoneKey = 3,
+  ExportRequestKey = 4,
+  SyncRequestKey = 5,
+  SyncChangesKey = 6,
+  SyncSequenceKey = 7,
+  SyncAckKey = 8,
+  ImportBeginKey = 9,
+  ImportRecordsKey = 10,
+  ImportDoneKey = 11,
+  ImportReadyKey = 12,
+  ExportArchiveCutoffKey = 13
+} MessageKey;
+
+// A message from the phone; records are already packed
+typedef struct {
+  uint32_t key;
+  uint32_t value;
+  uint16_t size;
+  uint8_t data[IMPORT_RECORDS_PER_CHUNK * LOG_RECORD_SIZE];
+} PhoneMessage;
+
+typedef struct {
+  // The phone's copy, newest first, and the sequence it has applied
+  Contraction records[MAX_NUMBER_OF_PHONE_RECORDS];
+  int number_of_records;
+  uint32_t sequence;
+
+  // A full export on its way in, and changes waiting for their sequence
+  Contraction received[MAX_NUMBER_OF_CONTRACTIONS];
+  int number_received;
+  Change pending_changes[MAX_NUMBER_OF_PENDING_CHANGES];
+  int number_of_pending_changes;
+
+  // Records waiting for the watch to take a restore
+  Contraction restore[MAX_NUMBER_OF_PHONE_RECORDS];
+  int number_to_restore;
+  int import_attempts;
+
+  // Sent to the watch once its outbox is free, as sendAppMessage queues them
+  PhoneMessage outbox[MAX_NUMBER_OF_PHONE_MESSAGES];
+  int outbox_head;
+  int outbox_length;
+
+  int messages_received;
+  int full_exports;
+  int change_syncs;
+  int import_refusals;
+} Phone;
+
+static Phone phone;
+
+static const char *storage_name;
+static const StorageBackend *storage;
+static const char *check_name;
+static int number_of_failures;
+
+#define EXPECT(condition) expect((condition), #condition, __LINE__)
+
+// Static functions
+static void expect(bool condition, const char *text, int line) {
+  if (!condition) {
+    printf("  %s on %s, line %d: %s\n", check_name, storage_name, line, text);
+    number_of_failures++;
+  }
+}
+
+// Version 1 keys are left to the migration, which deletes them. The RAM
+// backend is emptied too, in case the store fell back to it.
+static void clear_storage() {
+  harness_clear_persist();
+  for (uint32_t key = 0; key < MAX_STORE_KEY; key++) {
+    storage->delete(key);
+    storage_ram.delete(key);
+  }
+}
+
+// A launch on a watch the app was never installed on
+static void start_fresh_watch() {
+  store_deinit();
+  store_set_storage(storage);
+  clear_storage();
+  harness_set_time(DEFAULT_START_TIME);
+  calendar_init();
+  store_init();
+}
+
+// count records, newest at newest_start_time and spacing seconds apart
+static void insert_contractions(int count, time_t newest_start_time, int spacing, int duration) {
+  for (int i = count - 1; i >= 0; i--) {
+    store_insert_contraction(newest_start_time - (time_t)i * spacing, duration);
+  }
+}
+
+static void restart_watch() {
+  store_deinit();
+  store_init();
+}
+
+static void run_timers_for(uint32_t duration_ms) {
+  uint64_t until_ms = harness_now_ms() + duration_ms;
+  const char *label;
+  while (harness_run_next_event(until_ms, &label)) {
+  }
+}
+
+static uint32_t version_1_key_for_time(time_t start_time) {
+  struct tm *start_datetime = localtime(&start_time);
+  return start_datetime->tm_mon * 100000000 + start_datetime->tm_mday * 1000000 +
+    start_datetime->tm_hour * 10000 + start_datetime->tm_min * 100 + start_datetime->tm_sec;
+}
+
+// Replaces whatever is stored with a version 1 log, newest first
+static void write_version_1_log(uint32_t *keys, int count, time_t newest_start_time, int spacing) {
+  store_deinit();
+  clear_storage();
+
+  for (int i = 0; i < count; i++) {
+    Contraction contraction = { .start_time = newest_start_time - (time_t)i * spacing, .seconds_elapsed = 30 + i };
+    keys[i] = version_1_key_for_time(contraction.start_time);
+    storage->write(keys[i], &contraction, sizeof(contraction));
+  }
+  storage->write(VERSION_1_INDEX_KEY, keys, count * sizeof(uint32_t));
+}
+
+// The records a version 1 log written by write_version_1_log holds, or as
+// many of them as the capacity keeps
+static bool has_version_1_records(int count, time_t newest_start_time, int spacing) {
+  if (count > MAX_NUMBER_OF_CONTRACTIONS) {
+    count = MAX_NUMBER_OF_CONTRACTIONS;
+  }
+  if (store_number_of_past_contractions() != count) {
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    Contraction contraction;
+    store_contraction_at_index(i, &contraction);
+    if (contraction.start_time != newest_start_time - (time_t)i * spacing || contraction.seconds_elapsed != 30 + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool version_1_keys_are_gone(const uint32_t *keys, int count) {
+  for (int i = 0; i < count; i++) {
+    if (storage->exists(keys[i])) {
+      return false;
+    }
+  }
+  return !storage->exists(VERSION_1_INDEX_KEY);
+}
+
+static int copy_records(Contraction *records) {
+  int count = 0;
+  while (store_contraction_at_index(count, &records[count])) {
+    count++;
+  }
+  return count;
+}
+
+static bool has_records(const Contraction *records, int count) {
+  Contraction stored[MAX_NUMBER_OF_CONTRACTIONS];
+  if (copy_records(stored) != count) {
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (stored[i].start_time != records[i].start_time || stored[i].seconds_elapsed != records[i].seconds_elapsed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int archived_count() {
+  int count = 0;
+  DailyAggregate day;
+  for (int i = 0; store_archived_day(i, &day); i++) {
+    count += day.count;
+  }
+  return count;
+}
+
+static bool same_aggregate(const DailyAggregate *a, const DailyAggregate *b) {
+  return a->start_time == b->start_time && a->end_time == b->end_time && a->count == b->count &&
+    a->min_duration_in_seconds == b->min_duration_in_seconds && a->max_duration_in_seconds == b->max_duration_in_seconds &&
+    a->newest_duration_in_seconds == b->newest_duration_in_seconds &&
+    a->total_duration_in_seconds == b->total_duration_in_seconds && a->total_interval_in_seconds == b->total_interval_in_seconds;
+}
+
+// Phone
+static PhoneMessage *queue_phone_message(uint32_t key) {
+  EXPECT(phone.outbox_length < MAX_NUMBER_OF_PHONE_MESSAGES);
+  PhoneMessage *message = &phone.outbox[(phone.outbox_head + phone.outbox_length++) % MAX_NUMBER_OF_PHONE_MESSAGES];
+  message->key = key;
+  message->size = 0;
+  return message;
+}
+
+static void phone_send(uint32_t key, uint32_t value) {
+  queue_phone_message(key)->value = value;
+}
+
+static void phone_send_data(uint32_t key, const uint8_t *data, uint16_t size) {
+  PhoneMessage *message = queue_phone_message(key);
+  message->size = size;
+  memcpy(message->data, data, size);
+}
+
+static void deliver_phone_message() {
+  PhoneMessage *message = &phone.outbox[phone.outbox_head];
+  phone.outbox_head = (phone.outbox_head + 1) % MAX_NUMBER_OF_PHONE_MESSAGES;
+  phone.outbox_length--;
+
+  DictionaryIterator *iterator = harness_inbox_begin();
+  if (message->size > 0) {
+    dict_write_data(iterator, message->key, message->data, message->size);
+  } else {
+    dict_write_uint32(iterator, message->key, message->value);
+  }
+  harness_inbox_send();
+}
+
+static void phone_remove_record(time_t start_time) {
+  for (int i = 0; i < phone.number_of_records; i++) {
+    if (phone.records[i].start_time == start_time) {
+      memmove(&phone.records[i], &phone.records[i + 1], (phone.number_of_records - i - 1) * sizeof(Contraction));
+      phone.number_of_records--;
+      return;
+    }
+  }
+}
+
+static void phone_put_record(Contraction contraction) {
+  phone_remove_record(contraction.start_time);
+  int index = 0;
+  while (index < phone.number_of_records && phone.records[index].start_time > contraction.start_time) {
+    index++;
+  }
+  memmove(&phone.records[index + 1], &phone.records[index], (phone.number_of_records - index) * sizeof(Contraction));
+  phone.records[index] = contraction;
+  phone.number_of_records++;
+}
+
+static void phone_acknowledge(uint32_t sequence) {
+  phone.sequence = sequence;
+  phone_send(SyncAckKey, sequence);
+}
+
+static void phone_request_sync() {
+  phone_send(SyncRequestKey, phone.sequence);
+}
+
+static void phone_begin_restore() {
+  phone.import_attempts++;
+  phone_send(ImportBeginKey, 1);
+}
+
+// Newest first, then ImportDone; the watch sends the merged log by itself
+static void phone_send_restore() {
+  uint8_t bytes[IMPORT_RECORDS_PER_CHUNK * LOG_RECORD_SIZE];
+  for (int i = 0; i < phone.number_to_restore; i += IMPORT_RECORDS_PER_CHUNK) {
+    uint8_t *end = bytes;
+    for (int j = i; j < phone.number_to_restore && j < i + IMPORT_RECORDS_PER_CHUNK; j++) {
+      end = log_pack_record(end, phone.restore[j].start_time, phone.restore[j].seconds_elapsed);
+    }
+    phone_send_data(ImportRecordsKey, bytes, end - bytes);
+  }
+  phone_send(ImportDoneKey, 1);
+
+  phone.number_to_restore = 0;
+  phone.sequence = 0;
+}
+
+// Keeps the records the watch archived, as mergeExport does
+static void phone_merge_export(time_t archive_cutoff) {
+  int number_archived = 0;
+  for (int i = 0; i < phone.number_of_records; i++) {
+    if (phone.records[i].start_time <= archive_cutoff) {
+      phone.records[number_archived++] = phone.records[i];
+    }
+  }
+
+  memmove(&phone.records[phone.number_received], phone.records, number_archived * sizeof(Contraction));
+  memcpy(phone.records, phone.received, phone.number_received * sizeof(Contraction));
+  phone.number_of_records = phone.number_received + number_archived;
+}
+
+static void phone_receive_export(const DictionaryIterator *message, uint32_t offset) {
+  if (offset == 0) {
+    phone.number_received = 0;
+  }
+  if ((int)offset != phone.number_received) {
+    return;
+  }
+
+  Tuple *records = dict_find(message, ExportRecordsKey);
+  for (int i = 0; records != NULL && i + LOG_RECORD_SIZE <= records->length; i += LOG_RECORD_SIZE) {
+    uint32_t start_time;
+    uint16_t seconds_elapsed;
+    log_unpack_record(&records->value->data[i], &start_time, &seconds_elapsed);
+    if (phone.number_received < MAX_NUMBER_OF_CONTRACTIONS) {
+      phone.received[phone.number_received++] = (Contraction){ .start_time = start_time, .seconds_elapsed = seconds_elapsed };
+    }
+  }
+
+  if (dict_find(message, ExportDoneKey) == NULL) {
+    return;
+  }
+
+  int count = dict_find(message, ExportCountKey)->value->uint32;
+  Tuple *sequence_tuple = dict_find(message, SyncSequenceKey);
+  uint32_t sequence = sequence_tuple != NULL ? sequence_tuple->value->uint32 : 0;
+  if (phone.number_received != count) {
+    return;
+  }
+
+  // A watch that went back in sequence was reset; it gets what it lacks
+  if (sequence < phone.sequence) {
+    phone.number_to_restore = 0;
+    for (int i = 0; i < phone.number_of_records; i++) {
+      bool on_watch = false;
+      for (int j = 0; j < phone.number_received && !on_watch; j++) {
+        on_watch = phone.received[j].start_time == phone.records[i].start_time;
+      }
+      if (!on_watch) {
+        phone.restore[phone.number_to_restore++] = phone.records[i];
+      }
+    }
+    if (phone.number_to_restore > 0) {
+      phone.import_attempts = 0;
+      phone_begin_restore();
+      return;
+    }
+  }
+
+  Tuple *cutoff_tuple = dict_find(message, ExportArchiveCutoffKey);
+  phone_merge_export(cutoff_tuple != NULL ? cutoff_tuple->value->uint32 : 0);
+  phone.full_exports++;
+  phone_acknowledge(sequence);
+}
+
+static void phone_receive_changes(const DictionaryIterator *message) {
+  Tuple *changes = dict_find(message, SyncChangesKey);
+  for (int i = 0; changes != NULL && i + 1 + LOG_RECORD_SIZE <= changes->length; i += 1 + LOG_RECORD_SIZE) {
+    Change *change = &phone.pending_changes[phone.number_of_pending_changes++];
+    change->kind = changes->value->data[i];
+    log_unpack_record(&changes->value->data[i + 1], &change->start_time, &change->seconds_elapsed);
+  }
+
+  Tuple *sequence = dict_find(message, SyncSequenceKey);
+  if (sequence == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < phone.number_of_pending_changes; i++) {
+    Change change = phone.pending_changes[i];
+    if (change.kind == ChangeRemoveAll) {
+      phone.number_of_records = 0;
+    } else if (change.kind == ChangeRemove) {
+      phone_remove_record(change.start_time);
+    } else {
+      phone_put_record((Contraction){ .start_time = change.start_time, .seconds_elapsed = change.seconds_elapsed });
+    }
+  }
+  phone.number_of_pending_changes = 0;
+  phone.change_syncs++;
+  phone_acknowledge(sequence->value->uint32);
+}
+
+static void phone_receive(const DictionaryIterator *message) {
+  phone.messages_received++;
+
+  Tuple *tuple = dict_find(message, ImportReadyKey);
+  if (tuple != NULL) {
+    if (phone.number_to_restore == 0) {
+      return;
+    }
+    if (tuple->value->uint8 == 1) {
+      phone_send_restore();
+    } else {
+      phone.import_refusals++;
+    }
+    return;
+  }
+
+  tuple = dict_find(message, ExportOffsetKey);
+  if (tuple != NULL) {
+    phone_receive_export(message, tuple->value->uint32);
+  } else if (dict_find(message, SyncChangesKey) != NULL || dict_find(message, SyncSequenceKey) != NULL) {
+    phone_receive_changes(message);
+  }
+}
+
+// Carries messages both ways, and the watch's timers, until both sides are
+// quiet. The phone hears the watch's message before the watch learns it got
+// through, but its answers are queued until then, as they are on a phone.
+static void sync_with_phone() {
+  for (;;) {
+    const DictionaryIterator *message = harness_outbox_message();
+    const char *label;
+    if (message != NULL) {
+      phone_receive(message);
+      harness_finish_outbox(true);
+    } else if (phone.outbox_length > 0) {
+      deliver_phone_message();
+    } else if (harness_run_next_event(harness_now_ms() + IMPORT_RETRY_DELAY, &label)) {
+      continue;
+    } else if (phone.number_to_restore > 0 && phone.import_attempts < MAX_IMPORT_ATTEMPTS) {
+      // Refused or not answered; ask again
+      phone_begin_restore();
+    } else {
+      return;
+    }
+  }
+}
+
+// The watch's records, newest first, are the newest ones on the phone
+static bool phone_has_watch_records() {
+  Contraction records[MAX_NUMBER_OF_CONTRACTIONS];
+  int count = copy_records(records);
+  if (phone.number_of_records < count) {
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (phone.records[i].start_time != records[i].start_time || phone.records[i].seconds_elapsed != records[i].seconds_elapsed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void start_sync() {
+  memset(&phone, 0, sizeof(phone));
+  harness_set_connected(true);
+  export_init();
+}
+
+static void stop_sync() {
+  export_deinit();
+}
+
+static void run(const char *name, void (*check)()) {
+  check_name = name;
+  int failures_before = number_of_failures;
+
+  start_fresh_watch();
+  check();
+
+  printf("%s %s on %s\n", number_of_failures == failures_before ? "ok  " : "FAIL", name, storage_name);
+}
+
+// Checks
+// A full store that is all today keeps the labor in progress and only rolls
+// up its oldest record
+static void check_full_store_keeps_current_session() {
+  time_t now = harness_time(NULL);
+  int spacing = 4 * 60;
+  insert_contractions(MAX_NUMBER_OF_CONTRACTIONS, now - 60, spacing, 50);
+  EXPECT(store_number_of_past_contractions() == MAX_NUMBER_OF_CONTRACTIONS);
+  int count_in_last_hour = store_calculate_summary(60).count;
+
+  store_insert_contraction(now, 45);
+
+  EXPECT(store_number_of_past_contractions() == MAX_NUMBER_OF_CONTRACTIONS);
+  EXPECT(store_calculate_summary(60).count == count_in_last_hour + 1);
+  EXPECT(store_number_of_archived_days() == 1);
+  EXPECT(archived_count() == 1);
+  EXPECT(store_number_of_sessions() == 1);
+}
+
+// A full store whose oldest day is over and a session of its own rolls that
+// day up whole
+static void check_full_store_archives_finished_day() {
+  time_t now = harness_time(NULL);
+  int today_count = 4;
+  int yesterday_count = MAX_NUMBER_OF_CONTRACTIONS - today_count;
+  insert_contractions(today_count, now - 60, 10 * 60, 50);
+  insert_contractions(yesterday_count, now - 24 * HOUR, 60, 50);
+  EXPECT(store_number_of_past_contractions() == MAX_NUMBER_OF_CONTRACTIONS);
+
+  store_insert_contraction(now, 45);
+
+  EXPECT(store_number_of_past_contractions() == today_count + 1);
+  EXPECT(store_number_of_archived_days() == 1);
+  EXPECT(archived_count() == yesterday_count);
+}
+
+// A full store that is all today rolls up a record at a time; the pieces
+// add up to the day that record would have been rolled up into whole
+static void check_day_archived_in_pieces() {
+  time_t now = harness_time(NULL);
+  int spacing = 4 * 60;
+  int pieces = 5;
+  time_t oldest_start_time = now - 60 - (time_t)(MAX_NUMBER_OF_CONTRACTIONS - 1) * spacing;
+  for (int i = 0; i < MAX_NUMBER_OF_CONTRACTIONS; i++) {
+    store_insert_contraction(oldest_start_time + (time_t)i * spacing, 40 + i);
+  }
+  for (int i = 1; i <= pieces; i++) {
+    store_insert_contraction(now - 60 + (time_t)i * spacing, 40);
+  }
+  DailyAggregate in_pieces;
+  EXPECT(store_number_of_archived_days() == 1);
+  EXPECT(store_archived_day(0, &in_pieces));
+
+  // The same records, rolled up whole once they are old enough
+  start_fresh_watch();
+  for (int i = 0; i < pieces; i++) {
+    store_insert_contraction(oldest_start_time + (time_t)i * spacing, 40 + i);
+  }
+  harness_set_time(now + 3 * 24 * HOUR);
+  restart_watch();
+  DailyAggregate whole;
+  EXPECT(store_number_of_archived_days() == 1);
+  EXPECT(store_archived_day(0, &whole));
+
+  EXPECT(whole.total_interval_in_seconds == (uint32_t)(pieces - 1) * spacing);
+  EXPECT(same_aggregate(&in_pieces, &whole));
+}
+
+// A version 1 log is converted a chunk at a time into pages that read back
+// the same after a restart
+static void check_migration_from_version_1() {
+  time_t newest_start_time = harness_time(NULL) - 60;
+  int count = 40;
+  uint32_t keys[VERSION_1_MAX_NUMBER_OF_CONTRACTIONS];
+  write_version_1_log(keys, count, newest_start_time, 5 * 60);
+
+  store_init();
+  run_timers_for(1000);
+
+  EXPECT(has_version_1_records(count, newest_start_time, 5 * 60));
+  EXPECT(store_number_of_past_contractions() + archived_count() == count);
+  EXPECT(version_1_keys_are_gone(keys, count));
+
+  restart_watch();
+  EXPECT(has_version_1_records(count, newest_start_time, 5 * 60));
+}
+
+// A migration stopped between chunks resumes where it was on the next launch
+static void check_interrupted_migration_resumes() {
+  time_t newest_start_time = harness_time(NULL) - 60;
+  int count = VERSION_1_MAX_NUMBER_OF_CONTRACTIONS;
+  uint32_t keys[VERSION_1_MAX_NUMBER_OF_CONTRACTIONS];
+  write_version_1_log(keys, count, newest_start_time, 60);
+
+  store_init();
+  run_timers_for(120);
+  EXPECT(store_number_of_past_contractions() < count);
+  restart_watch();
+  run_timers_for(1000);
+
+  EXPECT(has_version_1_records(count, newest_start_time, 60));
+  EXPECT(store_number_of_past_contractions() + archived_count() == count);
+  EXPECT(version_1_keys_are_gone(keys, count));
+}
+
+// Records spread over several pages, edited in the middle, read back the
+// same after a restart
+static void check_pages_round_trip() {
+  time_t now = harness_time(NULL);
+  insert_contractions(MAX_NUMBER_OF_CONTRACTIONS, now - 60, 3 * 60, 40);
+
+  Contraction middle;
+  store_contraction_at_index(MAX_NUMBER_OF_CONTRACTIONS / 2, &middle);
+  store_replace_contraction(middle.start_time, middle.start_time - 30, 75);
+  store_contraction_at_index(1, &middle);
+  store_remove_contraction(middle.start_time);
+  store_insert_contraction(now, 20);
+
+  Contraction records[MAX_NUMBER_OF_CONTRACTIONS];
+  int count = copy_records(records);
+  restart_watch();
+
+  EXPECT(count == MAX_NUMBER_OF_CONTRACTIONS);
+  EXPECT(has_records(records, count));
+}
+
+// Sessions split only where a record ends more than the session gap before
+// the next one starts, and never where records overlap
+static void check_session_gaps() {
+  EXPECT(!summary_is_session_gap(DEFAULT_START_TIME, DEFAULT_START_TIME - 100, 200));
+  EXPECT(!summary_is_session_gap(DEFAULT_START_TIME, DEFAULT_START_TIME - 100, 100));
+  EXPECT(!summary_is_session_gap(DEFAULT_START_TIME, DEFAULT_START_TIME - SESSION_GAP_IN_SECONDS - 60, 60));
+  EXPECT(summary_is_session_gap(DEFAULT_START_TIME, DEFAULT_START_TIME - SESSION_GAP_IN_SECONDS - 61, 60));
+
+  time_t now = harness_time(NULL);
+  store_insert_contraction(now - 60, 50);
+  // Still running when the next one was started
+  store_insert_contraction(now - 200, 180);
+  store_insert_contraction(now - 200 - SESSION_GAP_IN_SECONDS - 30, 20);
+  store_insert_contraction(now - 400 - SESSION_GAP_IN_SECONDS, 60);
+
+  EXPECT(store_number_of_sessions() == 2);
+  Session session;
+  EXPECT(store_session(0, &session) && session.count == 2);
+  EXPECT(store_session(1, &session) && session.count == 2);
+
+  uint32_t start_times[] = { now - 60, now - 200 };
+  uint16_t durations[] = { 50, 180 };
+  EXPECT(summary_newest_session_length(start_times, durations, 2) == 2);
+}
+
+static int count_changes_after(uint32_t sequence) {
+  int count = 0;
+  Change change;
+  while (store_next_change(sequence, &change)) {
+    sequence = change.sequence;
+    count++;
+  }
+  return count;
+}
+
+// Staged changes show in the sections at once but reach the change log only
+// when they commit, and an abort leaves the sync sequence where it was
+static void check_transactions_sync_on_commit() {
+  time_t now = harness_time(NULL);
+  insert_contractions(3, now - 20 * 60, 5 * 60, 40);
+  uint32_t sequence = store_sync_sequence();
+
+  store_begin_transaction();
+  store_insert_contraction(now - 60, 30);
+  store_remove_contraction(now - 30 * 60);
+  EXPECT(store_number_of_past_contractions() == 3);
+  EXPECT(store_number_of_contractions_for_date_section(0) == 3);
+  EXPECT(store_sync_sequence() == sequence);
+  EXPECT(count_changes_after(sequence) == 0);
+  store_abort_transaction();
+
+  EXPECT(store_sync_sequence() == sequence);
+  EXPECT(store_number_of_past_contractions() == 3);
+  EXPECT(store_number_of_contractions_for_date_section(0) == 3);
+
+  store_begin_transaction();
+  store_insert_contraction(now - 60, 30);
+  store_remove_contraction(now - 30 * 60);
+  store_commit_transaction();
+  EXPECT(store_can_sync_from(sequence));
+  EXPECT(count_changes_after(sequence) == 2);
+
+  sequence = store_sync_sequence();
+  EXPECT(store_undo_last_transaction());
+  EXPECT(store_number_of_past_contractions() == 3);
+  EXPECT(count_changes_after(sequence) == 2);
+}
+
+// A transaction too big for the undo log cannot be described change by
+// change, so phones fall back to a full export
+static void check_big_transaction_needs_full_export() {
+  time_t now = harness_time(NULL);
+  store_insert_contraction(now - HOUR, 30);
+  uint32_t sequence = store_sync_sequence();
+
+  store_begin_transaction();
+  insert_contractions(20, now - 60, 2 * 60, 40);
+  store_commit_transaction();
+
+  EXPECT(!store_can_sync_from(sequence));
+  EXPECT(store_can_sync_from(store_sync_sequence()));
+  EXPECT(!store_can_undo());
+}
+
+// Staged changes leave the sections to be rebuilt once, by the commit
+static void check_transaction_rebuilds_dates_once() {
+  time_t now = harness_time(NULL);
+  insert_contractions(8, now - 6 * HOUR, 6 * HOUR, 40);
+  unsigned decoded_before = harness_counts.date_sections_decoded;
+
+  store_begin_transaction();
+  insert_contractions(8, now - 60, 5 * 60, 40);
+  EXPECT(harness_counts.date_sections_decoded == decoded_before);
+  store_commit_transaction();
+
+  unsigned decoded = harness_counts.date_sections_decoded - decoded_before;
+  EXPECT(decoded == (unsigned)store_number_of_date_sections());
+  int newest_length = store_number_of_contractions_for_date_section(0);
+
+  // A read in the middle of a transaction rebuilds them on its own
+  store_begin_transaction();
+  store_remove_contraction(now - 60);
+  EXPECT(store_number_of_contractions_for_date_section(0) == newest_length - 1);
+  decoded_before = harness_counts.date_sections_decoded;
+  store_commit_transaction();
+  EXPECT(harness_counts.date_sections_decoded - decoded_before == (unsigned)store_number_of_date_sections());
+}
+
+static int number_of_notifications;
+
+#define COUNTING_HANDLER(name) static void name(uint32_t data_version) { number_of_notifications++; }
+COUNTING_HANDLER(handler_0)
+COUNTING_HANDLER(handler_1)
+COUNTING_HANDLER(handler_2)
+COUNTING_HANDLER(handler_3)
+COUNTING_HANDLER(handler_4)
+COUNTING_HANDLER(handler_5)
+COUNTING_HANDLER(handler_6)
+COUNTING_HANDLER(handler_7)
+
+static const StoreChangedHandler handlers[] = {
+  handler_0, handler_1, handler_2, handler_3, handler_4, handler_5, handler_6, handler_7
+};
+#define NUMBER_OF_HANDLERS (int)(sizeof(handlers) / sizeof(handlers[0]))
+
+// There is room for every module that listens, a handler subscribed twice
+// takes one slot, and one that does not fit is refused rather than dropped
+static void check_subscribers() {
+  int number_subscribed = 0;
+  while (number_subscribed < NUMBER_OF_HANDLERS && store_subscribe(handlers[number_subscribed])) {
+    number_subscribed++;
+  }
+  EXPECT(number_subscribed >= 5);
+  EXPECT(number_subscribed < NUMBER_OF_HANDLERS);
+  EXPECT(store_subscribe(handlers[0]));
+
+  number_of_notifications = 0;
+  store_insert_contraction(harness_time(NULL), 30);
+  EXPECT(number_of_notifications == number_subscribed);
+
+  for (int i = 0; i < NUMBER_OF_HANDLERS; i++) {
+    store_unsubscribe(handlers[i]);
+  }
+}
+
+// After a full export, edits reach the phone as changes alone, at most a
+// message each, and once acknowledged they leave the change log
+static void check_sync_sends_only_changes() {
+  time_t now = harness_time(NULL);
+  insert_contractions(10, now - HOUR, 5 * 60, 40);
+  start_sync();
+
+  phone_request_sync();
+  sync_with_phone();
+  EXPECT(phone.full_exports == 1);
+  EXPECT(phone.number_of_records == 10);
+  EXPECT(phone_has_watch_records());
+
+  int messages_before = phone.messages_received;
+  store_insert_contraction(now - 60, 30);
+  Contraction contraction;
+  store_contraction_at_index(3, &contraction);
+  store_replace_contraction(contraction.start_time, contraction.start_time + 20, 55);
+  store_contraction_at_index(5, &contraction);
+  store_remove_contraction(contraction.start_time);
+  sync_with_phone();
+
+  EXPECT(phone.full_exports == 1);
+  EXPECT(phone.change_syncs > 0);
+  EXPECT(phone.messages_received - messages_before <= 3);
+  EXPECT(phone.number_of_records == 10);
+  EXPECT(phone_has_watch_records());
+  EXPECT(phone.sequence == store_sync_sequence());
+  Change change;
+  EXPECT(!store_next_change(0, &change));
+
+  stop_sync();
+}
+
+// A phone that was away for more changes than the change log holds gets a
+// full export when it comes back
+static void check_sync_falls_back_past_floor() {
+  time_t now = harness_time(NULL);
+  insert_contractions(4, now - HOUR, 5 * 60, 40);
+  start_sync();
+  phone_request_sync();
+  sync_with_phone();
+  uint32_t phone_sequence = phone.sequence;
+
+  harness_set_connected(false);
+  int number_of_changes = PERSIST_DATA_MAX_LENGTH / sizeof(Change);
+  insert_contractions(number_of_changes, now - 60, 60, 20);
+  sync_with_phone();
+  EXPECT(phone.sequence == phone_sequence);
+  EXPECT(!store_can_sync_from(phone_sequence));
+
+  harness_set_connected(true);
+  sync_with_phone();
+  EXPECT(phone.full_exports == 2);
+  EXPECT(phone_has_watch_records());
+  EXPECT(phone.number_of_records == store_number_of_past_contractions());
+  EXPECT(phone.sequence == store_sync_sequence());
+
+  stop_sync();
+}
+
+// Records the watch rolled up into daily totals stay on the phone through a
+// full export
+static void check_full_export_keeps_archived_records() {
+  time_t now = harness_time(NULL);
+  int old_count = MAX_NUMBER_OF_CONTRACTIONS / 2;
+  insert_contractions(old_count, now - 3 * 24 * HOUR, 10 * 60, 40);
+  start_sync();
+  phone_request_sync();
+  sync_with_phone();
+  EXPECT(phone.number_of_records == old_count);
+
+  insert_contractions(MAX_NUMBER_OF_CONTRACTIONS, now - 60, 4 * 60, 50);
+  EXPECT(archived_count() > 0);
+  sync_with_phone();
+
+  EXPECT(phone.full_exports == 2);
+  EXPECT(phone_has_watch_records());
+  EXPECT(phone.number_of_records == old_count + MAX_NUMBER_OF_CONTRACTIONS);
+
+  stop_sync();
+}
+
+// Puts and removes records until the change log no longer holds what a
+// phone away all along has not had, leaving the records as they were
+static void overflow_change_log(time_t start_time) {
+  int number_of_changes = PERSIST_DATA_MAX_LENGTH / sizeof(Change);
+  for (int i = 0; i < number_of_changes; i++) {
+    store_insert_contraction(start_time + i, 20);
+    store_remove_contraction(start_time + i);
+  }
+}
+
+// Records deleted on the watch are gone from the phone after a full export,
+// however old they were
+static void check_full_export_drops_deleted_records() {
+  time_t now = harness_time(NULL);
+  insert_contractions(10, now - HOUR, 5 * 60, 40);
+  start_sync();
+  phone_request_sync();
+  sync_with_phone();
+  EXPECT(phone.number_of_records == 10);
+
+  harness_set_connected(false);
+  Contraction oldest;
+  store_contraction_at_index(9, &oldest);
+  store_remove_contraction(oldest.start_time);
+  overflow_change_log(now - 10 * 60);
+  harness_set_connected(true);
+  sync_with_phone();
+
+  EXPECT(phone.full_exports == 2);
+  EXPECT(phone.number_of_records == 9);
+  EXPECT(phone_has_watch_records());
+
+  harness_set_connected(false);
+  store_remove_all_contractions();
+  overflow_change_log(now - 10 * 60);
+  harness_set_connected(true);
+  sync_with_phone();
+
+  EXPECT(phone.full_exports == 3);
+  EXPECT(phone.number_of_records == 0);
+
+  stop_sync();
+}
+
+// Fills the phone with count records, newest first, that the watch has
+// never seen, as if it had synced with another watch up to sequence
+static void fill_phone(int count, time_t newest_start_time, int spacing, uint32_t sequence) {
+  for (int i = 0; i < count; i++) {
+    phone.records[i] = (Contraction){ .start_time = newest_start_time - (time_t)i * spacing, .seconds_elapsed = 30 + i % 60 };
+  }
+  phone.number_of_records = count;
+  phone.sequence = sequence;
+}
+
+// A reset watch gets the phone's records back, and the phone keeps the ones
+// the watch has no room for and rolls up
+static void check_restore_keeps_archived_records() {
+  time_t now = harness_time(NULL);
+  int count = 3 * MAX_NUMBER_OF_CONTRACTIONS;
+  start_sync();
+  fill_phone(count, now - 60, 20 * 60, 50);
+
+  phone_request_sync();
+  sync_with_phone();
+
+  EXPECT(phone.full_exports == 1);
+  EXPECT(phone.number_of_records == count);
+  EXPECT(phone_has_watch_records());
+  EXPECT(store_number_of_past_contractions() + archived_count() == count);
+  EXPECT(phone.sequence == store_sync_sequence());
+
+  stop_sync();
+}
+
+// A restore that reaches the watch while it converts a version 1 log is
+// refused, and taken once the conversion is done
+static void check_restore_waits_for_migration() {
+  time_t newest_start_time = harness_time(NULL) - 60;
+  int count = MAX_NUMBER_OF_CONTRACTIONS / 2;
+  uint32_t keys[VERSION_1_MAX_NUMBER_OF_CONTRACTIONS];
+  write_version_1_log(keys, count, newest_start_time, 5 * 60);
+  store_init();
+  start_sync();
+  fill_phone(count, newest_start_time - count * 5 * 60, 5 * 60, 50);
+
+  phone_request_sync();
+  sync_with_phone();
+
+  EXPECT(phone.import_refusals > 0);
+  EXPECT(store_number_of_past_contractions() == 2 * count);
+  EXPECT(phone.number_of_records == 2 * count);
+  EXPECT(phone_has_watch_records());
+
+  stop_sync();
+}
+
+// Persist that stops taking writes leaves the log in RAM for the rest of
+// the run, with nothing lost
+static void check_failed_write_falls_back_to_ram() {
+  FlashModel model = harness_flash_model();
+  time_t now = harness_time(NULL);
+  store_set_disclaimer_shown(true);
+  insert_contractions(10, now - 2 * HOUR, 5 * 60, 40);
+  unsigned failures_before = harness_counts.persist_failures;
+
+  FlashModel full_model = model;
+  full_model.storage_budget = harness_storage_used();
+  harness_set_flash_model(full_model);
+  insert_contractions(10, now - 60, 5 * 60, 40);
+
+  EXPECT(harness_counts.persist_failures > failures_before);
+  EXPECT(store_number_of_past_contractions() == 20);
+  restart_watch();
+  EXPECT(store_number_of_past_contractions() == 20);
+  EXPECT(!store_should_show_disclaimer());
+
+  harness_set_flash_model(model);
+}
+
+static void run_checks() {
+  run("full store keeps the current session", check_full_store_keeps_current_session);
+  run("full store archives a finished day", check_full_store_archives_finished_day);
+  run("day archived in pieces", check_day_archived_in_pieces);
+  run("migration from version 1", check_migration_from_version_1);
+  run("interrupted migration resumes", check_interrupted_migration_resumes);
+  run("pages round trip", check_pages_round_trip);
+  run("session gaps", check_session_gaps);
+  run("subscribers", check_subscribers);
+  run("transactions sync on commit", check_transactions_sync_on_commit);
+  run("big transaction needs a full export", check_big_transaction_needs_full_export);
+  run("transaction rebuilds dates once", check_transaction_rebuilds_dates_once);
+  run("sync sends only changes", check_sync_sends_only_changes);
+  run("sync falls back past the floor", check_sync_falls_back_past_floor);
+  run("full export keeps archived records", check_full_export_keeps_archived_records);
+  run("full export drops deleted records", check_full_export_drops_deleted_records);
+  run("restore keeps archived records", check_restore_keeps_archived_records);
+  run("restore waits for a migration", check_restore_waits_for_migration);
+  if (storage == &storage_persist) {
+    run("failed write falls back to RAM", check_failed_write_falls_back_to_ram);
+  }
+}
+
+int main() {
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  char directory[] = "/tmp/checks-XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  file_storage_set_directory(directory);
+
+  storage_name = "persist";
+  storage = &storage_persist;
+  run_checks();
+  storage_name = "RAM";
+  storage = &storage_ram;
+  run_checks();
+  storage_name = "files";
+  storage = &file_storage;
+  run_checks();
+
+  store_deinit();
+  clear_storage();
+  rmdir(directory);
+
+  if (number_of_failures > 0) {
+    printf("%d expectations failed\n", number_of_failures);
+    return 1;
+  }
+  return 0;
+}
\ No newline at end of file
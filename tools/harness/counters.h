@@ -0,0 +1,19 @@
+#pragma once
+// Force-included into the app's sources by the Makefile: counts the calls
+// the harness reports and puts the app on the harness clock
+#include "harness.h"
+
+#define snprintf(...) (harness_counts.snprintf_calls++, snprintf(__VA_ARGS__))
+#define localtime(...) (harness_counts.localtime_calls++, localtime(__VA_ARGS__))
+#define time(...) harness_time(__VA_ARGS__)
+
+// Calls into the store from everywhere but the store itself; store_calls.h
+// is generated from store.h
+#ifndef HARNESS_STORE_SOURCE
+#include "store.h"
+#include "store_calls.h"
+#else
+// The store looks up the month and day once for each date section it decodes
+#include "calendar.h"
+#define calendar_month_day_for_day(...) (harness_counts.date_sections_decoded++, calendar_month_day_for_day(__VA_ARGS__))
+#endif
\ No newline at end of file
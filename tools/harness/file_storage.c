@@ -0,0 +1,79 @@
+#include <errno.h>
+#include "file_storage.h"
+
+#define MAX_PATH_LENGTH 1024
+
+// Leaves room in a path for the key
+static char directory_path[MAX_PATH_LENGTH - 16] = ".";
+
+// Static functions
+static void path_for_key(char *path, uint32_t key) {
+  snprintf(path, MAX_PATH_LENGTH, "%s/%u", directory_path, (unsigned)key);
+}
+
+static bool file_exists_handler(uint32_t key) {
+  char path[MAX_PATH_LENGTH];
+  path_for_key(path, key);
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+static int file_read_handler(uint32_t key, void *buffer, size_t buffer_size) {
+  char path[MAX_PATH_LENGTH];
+  path_for_key(path, key);
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = fread(buffer, 1, buffer_size, file);
+  fclose(file);
+  return size;
+}
+
+// Same size limit as persist, so the store behaves the same on either
+static int file_write_handler(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) {
+    size = PERSIST_DATA_MAX_LENGTH;
+  }
+
+  char path[MAX_PATH_LENGTH];
+  path_for_key(path, key);
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return E_ERROR;
+  }
+  size_t written = fwrite(data, 1, size, file);
+  if (fclose(file) != 0 || written != size) {
+    return E_OUT_OF_STORAGE;
+  }
+  return size;
+}
+
+static status_t file_delete_handler(uint32_t key) {
+  char path[MAX_PATH_LENGTH];
+  path_for_key(path, key);
+
+  if (remove(path) != 0) {
+    return errno == ENOENT ? E_DOES_NOT_EXIST : E_ERROR;
+  }
+  return S_SUCCESS;
+}
+
+// Non-static functions
+void file_storage_set_directory(const char *directory) {
+  snprintf(directory_path, sizeof(directory_path), "%s", directory);
+}
+
+const StorageBackend file_storage = {
+  .exists = file_exists_handler,
+  .read = file_read_handler,
+  .write = file_write_handler,
+  .delete = file_delete_handler,
+};
\ No newline at end of file
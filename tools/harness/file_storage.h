@@ -0,0 +1,8 @@
+#pragma once
+#include "storage.h"
+
+// One file per key, named after the key in decimal, so a run can start from
+// a saved set of values and leave its own behind for the next one
+void file_storage_set_directory(const char *directory);
+
+extern const StorageBackend file_storage;
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "harness.h"
+#include "calendar.h"
+#include "store.h"
+#include "disclaimer.h"
+#include "menu.h"
+#include "summary.h"
+#include "chart.h"
+#include "new_contraction.h"
+#include "past_contractions.h"
+#include "contraction_menu.h"
+#include "edit_contraction.h"
+#include "delete_contraction.h"
+#include "file_storage.h"
+
+// Runs the app's screens headlessly from a script and reports, for every
+// press, timer, tick and frame, the store calls, persist operations, flash
+// time, localtime calls and snprintf calls it took. See browse.txt for the
+// script commands.
+
+#define MAX_LINE_LENGTH 256
+#define MAX_EVENT_LENGTH (MAX_LINE_LENGTH + 16)
+#define DEFAULT_START_TIME 1400000000
+// Time between presses, in which redraws the app deferred get to run
+#define PRESS_INTERVAL_MS 250
+
+static int line_number;
+static bool app_started;
+
+// Static functions
+static void reset_counts() {
+  memset(&harness_counts, 0, sizeof(harness_counts));
+}
+
+static void report(const char *event) {
+  printf("%-16s store=%u persist=%ur/%uw/%ud flash=%u.%03ums localtime=%u snprintf=%u",
+    event,
+    harness_counts.store_calls,
+    harness_counts.persist_reads,
+    harness_counts.persist_writes,
+    harness_counts.persist_deletes,
+    harness_counts.flash_stall_us / 1000,
+    harness_counts.flash_stall_us % 1000,
+    harness_counts.localtime_calls,
+    harness_counts.snprintf_calls);
+  if (harness_counts.persist_failures > 0) {
+    printf(" failed=%u", harness_counts.persist_failures);
+  }
+  printf("\n");
+  reset_counts();
+}
+
+static void render() {
+  if (harness_render_if_dirty()) {
+    char event[MAX_EVENT_LENGTH];
+    snprintf(event, sizeof(event), "frame %s", harness_top_window_name());
+    report(event);
+  }
+}
+
+// Reports what the event did, then the frame it caused
+static void finish_event(const char *event) {
+  report(event);
+  render();
+}
+
+static void run_until(uint64_t until_ms) {
+  const char *label;
+  while (harness_run_next_event(until_ms, &label)) {
+    finish_event(label);
+  }
+}
+
+static void init_app() {
+  calendar_init();
+  harness_name_windows("timer");
+  new_contraction_init();
+  harness_name_windows("timer");
+  store_init();
+
+  disclaimer_init();
+  harness_name_windows("disclaimer");
+  menu_init();
+  harness_name_windows("menu");
+  summary_init();
+  harness_name_windows("summary");
+  chart_init();
+  harness_name_windows("chart");
+  past_contractions_init();
+  harness_name_windows("past");
+  contraction_menu_init();
+  harness_name_windows("contraction");
+  edit_contraction_init();
+  harness_name_windows("edit");
+  delete_contraction_init();
+  harness_name_windows("delete");
+}
+
+// The clock and the flash model can be set up before the app starts, so
+// that init is reported under them
+static void start_app() {
+  if (!app_started) {
+    app_started = true;
+    init_app();
+    finish_event("init");
+  }
+}
+
+static bool parse_button(const char *name, ButtonId *button) {
+  static const char *names[NUM_BUTTONS] = { "back", "up", "select", "down" };
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *button = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void show(const char *screen) {
+  if (strcmp(screen, "menu") == 0) {
+    show_menu();
+  } else if (strcmp(screen, "summary") == 0) {
+    show_summary();
+  } else if (strcmp(screen, "chart") == 0) {
+    show_chart();
+  } else if (strcmp(screen, "past") == 0) {
+    show_past_contractions();
+  } else if (strcmp(screen, "timer") == 0) {
+    show_new_contraction();
+  } else if (strcmp(screen, "disclaimer") == 0) {
+    show_disclaimer();
+  } else {
+    fprintf(stderr, "line %d: unknown screen %s\n", line_number, screen);
+    return;
+  }
+
+  char event[MAX_EVENT_LENGTH];
+  snprintf(event, sizeof(event), "show %s", screen);
+  finish_event(event);
+}
+
+static void press(ButtonId button, const char *name, int count) {
+  char event[MAX_EVENT_LENGTH];
+  snprintf(event, sizeof(event), "press %s", name);
+
+  for (int i = 0; i < count; i++) {
+    if (!harness_click(button, 1)) {
+      fprintf(stderr, "line %d: nothing handles %s on %s\n", line_number, name, harness_top_window_name());
+    }
+    finish_event(event);
+    run_until(harness_now_ms() + PRESS_INTERVAL_MS);
+  }
+}
+
+// Holds a button past the long click delay, for the screens that tell a
+// long click from a short one
+static void long_press(ButtonId button, const char *name) {
+  char event[MAX_EVENT_LENGTH];
+  snprintf(event, sizeof(event), "long %s", name);
+
+  if (!harness_long_click(button)) {
+    fprintf(stderr, "line %d: nothing handles a long %s on %s\n", line_number, name, harness_top_window_name());
+  }
+  finish_event(event);
+  run_until(harness_now_ms() + PRESS_INTERVAL_MS);
+}
+
+// A held button repeats at the interval it was subscribed with, and the
+// clock runs between repeats
+static void hold(ButtonId button, const char *name, int repeats) {
+  char event[MAX_EVENT_LENGTH];
+  snprintf(event, sizeof(event), "hold %s", name);
+
+  harness_click(button, 1);
+  finish_event(event);
+
+  for (int i = 0; i < repeats; i++) {
+    uint16_t repeat_interval = harness_repeat_interval(button);
+    if (repeat_interval == 0) {
+      fprintf(stderr, "line %d: %s does not repeat on %s\n", line_number, name, harness_top_window_name());
+      return;
+    }
+
+    run_until(harness_now_ms() + repeat_interval);
+    harness_click(button, i + 2);
+    finish_event(event);
+  }
+}
+
+// Inserts contractions without reporting, so scripts start from a full store
+static void seed(int count, int spacing, int duration) {
+  time_t now = harness_time(NULL);
+  for (int i = count; i > 0; i--) {
+    store_insert_contraction(now - (time_t)i * spacing, duration);
+  }
+  harness_render_if_dirty();
+  reset_counts();
+}
+
+// Takes name/value pairs, e.g. "flash read 80 write 2000 budget 4096"
+static void set_flash_model(char *arguments) {
+  FlashModel model = harness_flash_model();
+
+  char *name = strtok(arguments, " \t\n");
+  char *value = strtok(NULL, " \t\n");
+  for (; name != NULL && value != NULL; name = strtok(NULL, " \t\n"), value = strtok(NULL, " \t\n")) {
+    unsigned long number = strtoul(value, NULL, 10);
+    if (strcmp(name, "read") == 0) {
+      model.read_cost_us = number;
+    } else if (strcmp(name, "write") == 0) {
+      model.write_cost_us = number;
+    } else if (strcmp(name, "delete") == 0) {
+      model.delete_cost_us = number;
+    } else if (strcmp(name, "limit") == 0) {
+      model.max_value_size = number;
+    } else if (strcmp(name, "budget") == 0) {
+      model.storage_budget = number;
+    } else {
+      fprintf(stderr, "line %d: unknown flash setting %s\n", line_number, name);
+    }
+  }
+
+  harness_set_flash_model(model);
+}
+
+static void set_storage(const char *name, const char *directory) {
+  if (strcmp(name, "persist") == 0) {
+    store_set_storage(&storage_persist);
+  } else if (strcmp(name, "ram") == 0) {
+    store_set_storage(&storage_ram);
+  } else if (strcmp(name, "file") == 0 && directory[0] != '\0') {
+    file_storage_set_directory(directory);
+    store_set_storage(&file_storage);
+  } else {
+    fprintf(stderr, "line %d: unknown storage %s\n", line_number, name);
+  }
+}
+
+static void run_line(char *line) {
+  char command[MAX_LINE_LENGTH];
+  char argument[MAX_LINE_LENGTH];
+  long numbers[3] = { 0, 0, 0 };
+
+  char *comment = strchr(line, '#');
+  if (comment != NULL) {
+    *comment = '\0';
+  }
+  if (sscanf(line, "%255s", command) != 1) {
+    return;
+  }
+
+  if (strcmp(command, "now") == 0 && sscanf(line, "%*s %ld", &numbers[0]) == 1) {
+    harness_set_time(numbers[0]);
+    return;
+  }
+  if (strcmp(command, "flash") == 0) {
+    set_flash_model(strstr(line, "flash") + strlen("flash"));
+    return;
+  }
+  if (strcmp(command, "backend") == 0 && !app_started) {
+    char directory[MAX_LINE_LENGTH] = "";
+    if (sscanf(line, "%*s %255s %255s", argument, directory) >= 1) {
+      set_storage(argument, directory);
+    }
+    return;
+  }
+
+  start_app();
+  if (strcmp(command, "storage") == 0) {
+    printf("storage          used=%d/%u keys=%d\n", harness_storage_used(), harness_flash_model().storage_budget, harness_number_of_persist_keys());
+  } else if (strcmp(command, "seed") == 0 && sscanf(line, "%*s %ld %ld %ld", &numbers[0], &numbers[1], &numbers[2]) == 3) {
+    seed(numbers[0], numbers[1], numbers[2]);
+  } else if (strcmp(command, "insert") == 0 && sscanf(line, "%*s %ld %ld", &numbers[0], &numbers[1]) == 2) {
+    store_insert_contraction(harness_time(NULL) - numbers[0], numbers[1]);
+    finish_event("insert");
+  } else if (strcmp(command, "show") == 0 && sscanf(line, "%*s %255s", argument) == 1) {
+    show(argument);
+  } else if (strcmp(command, "wait") == 0 && sscanf(line, "%*s %ld", &numbers[0]) == 1) {
+    run_until(harness_now_ms() + numbers[0]);
+  } else if ((strcmp(command, "press") == 0 || strcmp(command, "hold") == 0 || strcmp(command, "long") == 0) && sscanf(line, "%*s %255s %ld", argument, &numbers[0]) >= 1) {
+    ButtonId button;
+    if (!parse_button(argument, &button)) {
+      fprintf(stderr, "line %d: unknown button %s\n", line_number, argument);
+    } else if (command[0] == 'p') {
+      press(button, argument, numbers[0] > 0 ? numbers[0] : 1);
+    } else if (command[0] == 'l') {
+      long_press(button, argument);
+    } else {
+      hold(button, argument, numbers[0]);
+    }
+  } else {
+    fprintf(stderr, "line %d: cannot run %s", line_number, line);
+  }
+}
+
+int main(int argc, char **argv) {
+  FILE *script = stdin;
+  if (argc > 1 && (script = fopen(argv[1], "r")) == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  // Keep the report in step with the diagnostics on stderr
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  harness_set_time(DEFAULT_START_TIME);
+
+  char line[MAX_LINE_LENGTH];
+  while (fgets(line, sizeof(line), script) != NULL) {
+    line_number++;
+    run_line(line);
+  }
+
+  start_app();
+
+  if (script != stdin) {
+    fclose(script);
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <pebble.h>
+
+// What the harness counts; reset by the runner between reports
+typedef struct {
+  unsigned store_calls;
+  unsigned persist_reads;
+  unsigned persist_writes;
+  unsigned persist_deletes;
+  unsigned persist_failures;
+  // Time the watch would have spent waiting on flash
+  uint32_t flash_stall_us;
+  unsigned localtime_calls;
+  unsigned snprintf_calls;
+  unsigned date_sections_decoded;
+} HarnessCounts;
+
+extern HarnessCounts harness_counts;
+
+// Virtual clock, in place of time() for the app
+time_t harness_time(time_t *tloc);
+void harness_set_time(time_t time);
+
+// Cost of each persist operation and the limits of the persist stand-in.
+// Sizes are in bytes; the budget counts value bytes over all keys.
+typedef struct {
+  uint32_t read_cost_us;
+  uint32_t write_cost_us;
+  uint32_t delete_cost_us;
+  uint16_t max_value_size;
+  uint32_t storage_budget;
+} FlashModel;
+
+void harness_set_flash_model(FlashModel model);
+FlashModel harness_flash_model(void);
+int harness_storage_used(void);
+int harness_number_of_persist_keys(void);
+// Empties persist, as on a watch the app was never installed on
+void harness_clear_persist(void);
+
+// Names every window created since the last call, for the report
+void harness_name_windows(const char *name);
+const char *harness_top_window_name(void);
+
+// Delivers a click to the top window; false if nothing handles the button
+bool harness_click(ButtonId button, uint8_t clicks_counted);
+bool harness_long_click(ButtonId button);
+uint16_t harness_repeat_interval(ButtonId button);
+
+// Fires the next timer or tick due by until_ms and names it, or moves the
+// clock to until_ms and returns false
+bool harness_run_next_event(uint64_t until_ms, const char **label);
+uint64_t harness_now_ms(void);
+
+// AppMessage, as the phone sees it. What the app sends waits in the outbox
+// until the phone finishes it; only then does the app hear it was sent or
+// failed. The phone writes a message to the app with the dict_write calls
+// between harness_inbox_begin and harness_inbox_send.
+const DictionaryIterator *harness_outbox_message(void);
+void harness_finish_outbox(bool delivered);
+DictionaryIterator *harness_inbox_begin(void);
+void harness_inbox_send(void);
+void harness_set_connected(bool connected);
+
+// Unloads the windows popped since the last frame, then draws the top window
+// if anything was marked dirty
+bool harness_render_if_dirty(void);
\ No newline at end of file
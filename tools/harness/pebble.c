@@ -0,0 +1,1393 @@
+#include <stdarg.h>
+#include "harness.h"
+
+// Host stand-ins for the SDK calls the app makes. Layers form the same tree
+// as on the watch; drawing only walks it, so the work counted per frame is
+// the app's own: update procs and menu callbacks.
+
+#define SCREEN_WIDTH 144
+#define SCREEN_HEIGHT 152
+#define MAX_WINDOW_STACK_SIZE 8
+#define MAX_NUMBER_OF_WINDOWS 16
+// Enough for a version 1 log, which took a key per record
+#define MAX_NUMBER_OF_PERSIST_KEYS 128
+#define MENU_CELL_HEIGHT 44
+#define SCROLL_STEP 32
+// What the SDK gives each app
+#define DEFAULT_STORAGE_BUDGET 4096
+#define APP_MESSAGE_SIZE_MAXIMUM 656
+#define TUPLE_HEADER_SIZE 7
+
+typedef enum {
+  PlainLayerKind,
+  TextLayerKind,
+  MenuLayerKind,
+  ScrollLayerKind,
+  ActionBarLayerKind,
+  BitmapLayerKind
+} LayerKind;
+
+struct Layer {
+  LayerKind kind;
+  GRect frame;
+  bool hidden;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+};
+
+struct MenuLayer {
+  Layer layer;
+  MenuLayerCallbacks callbacks;
+  void *context;
+  MenuIndex selected_index;
+};
+
+struct ScrollLayer {
+  Layer layer;
+  ScrollLayerCallbacks callbacks;
+  GSize content_size;
+  int16_t content_offset;
+};
+
+struct ActionBarLayer {
+  Layer layer;
+  Window *window;
+  ClickConfigProvider click_config_provider;
+};
+
+struct BitmapLayer {
+  Layer layer;
+  const GBitmap *bitmap;
+};
+
+struct GBitmap {
+  GSize size;
+  uint16_t bytes_per_row;
+  uint8_t *data;
+};
+
+struct GContext {
+  GColor fill_color;
+};
+
+typedef struct {
+  ClickHandler handler;
+  uint16_t repeat_interval_ms;
+  // Only the down handler; the harness does not model releases
+  ClickHandler long_handler;
+} ClickSubscription;
+
+struct Window {
+  Layer root_layer;
+  WindowHandlers handlers;
+  ClickConfigProvider click_config_provider;
+  void *click_config_context;
+  ClickSubscription clicks[NUM_BUTTONS];
+  bool is_loaded;
+  const char *name;
+};
+
+typedef struct {
+  ButtonId button;
+  uint8_t clicks_counted;
+  bool is_repeating;
+} ClickRecognizer;
+
+struct AppTimer {
+  uint64_t fire_time_ms;
+  AppTimerCallback callback;
+  void *data;
+  AppTimer *next;
+};
+
+typedef struct {
+  uint32_t key;
+  int size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistValue;
+
+// A dictionary in the SDK's layout: a tuple count, then the tuples
+struct DictionaryIterator {
+  uint32_t capacity;
+  uint32_t size;
+  uint8_t buffer[APP_MESSAGE_SIZE_MAXIMUM];
+};
+
+HarnessCounts harness_counts;
+
+static uint64_t now_ms;
+static bool is_dirty;
+
+static Window *window_stack[MAX_WINDOW_STACK_SIZE];
+static int window_stack_size;
+static Window *windows[MAX_NUMBER_OF_WINDOWS];
+static int number_of_windows;
+static Window *configuring_window;
+// Popped windows stay loaded until the event that popped them is over, as
+// they do on the watch while the transition runs
+static Window *windows_to_unload[MAX_WINDOW_STACK_SIZE];
+static int number_of_windows_to_unload;
+
+static AppTimer *timers;
+
+static TimeUnits tick_units;
+static TickHandler tick_handler;
+static time_t last_tick_time;
+
+static PersistValue persist_values[MAX_NUMBER_OF_PERSIST_KEYS];
+static int number_of_persist_values;
+static int storage_used;
+
+// Free and unlimited but for the SDK's value size until a script says
+// otherwise
+static FlashModel flash_model = {
+  .max_value_size = PERSIST_DATA_MAX_LENGTH,
+  .storage_budget = DEFAULT_STORAGE_BUDGET,
+};
+// Stall time not yet whole enough to move the millisecond clock
+static uint32_t stall_remainder_us;
+
+static uint32_t inbox_size;
+static uint32_t outbox_size;
+static DictionaryIterator inbox;
+static DictionaryIterator outbox;
+static bool outbox_is_pending;
+static AppMessageInboxReceived inbox_received_callback;
+static AppMessageOutboxSent outbox_sent_callback;
+static AppMessageOutboxFailed outbox_failed_callback;
+
+static bool is_connected = true;
+static ConnectionHandler connection_handler;
+
+// Static functions
+static void init_layer(Layer *layer, LayerKind kind, GRect frame) {
+  memset(layer, 0, sizeof(*layer));
+  layer->kind = kind;
+  layer->frame = frame;
+}
+
+static void remove_from_parent(Layer *layer) {
+  if (layer->parent == NULL) {
+    return;
+  }
+
+  Layer **link = &layer->parent->first_child;
+  while (*link != NULL && *link != layer) {
+    link = &(*link)->next_sibling;
+  }
+  if (*link == layer) {
+    *link = layer->next_sibling;
+  }
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+  is_dirty = true;
+}
+
+static Window *top_window() {
+  return window_stack_size > 0 ? window_stack[window_stack_size - 1] : NULL;
+}
+
+static void configure_clicks(Window *window) {
+  memset(window->clicks, 0, sizeof(window->clicks));
+  if (window->click_config_provider != NULL) {
+    configuring_window = window;
+    window->click_config_provider(window->click_config_context);
+    configuring_window = NULL;
+  }
+}
+
+static void subscribe_click(ButtonId button, uint16_t repeat_interval_ms, ClickHandler handler) {
+  if (configuring_window != NULL) {
+    configuring_window->clicks[button].handler = handler;
+    configuring_window->clicks[button].repeat_interval_ms = repeat_interval_ms;
+  }
+}
+
+static void cancel_unload(Window *window) {
+  for (int i = 0; i < number_of_windows_to_unload; i++) {
+    if (windows_to_unload[i] == window) {
+      windows_to_unload[i] = windows_to_unload[--number_of_windows_to_unload];
+      return;
+    }
+  }
+}
+
+static void unload_popped_windows() {
+  while (number_of_windows_to_unload > 0) {
+    Window *window = windows_to_unload[--number_of_windows_to_unload];
+    window->is_loaded = false;
+    if (window->handlers.unload != NULL) {
+      window->handlers.unload(window);
+    }
+  }
+}
+
+static void appear(Window *window) {
+  if (window->handlers.appear != NULL) {
+    window->handlers.appear(window);
+  }
+  configure_clicks(window);
+  is_dirty = true;
+}
+
+static void disappear(Window *window) {
+  if (window->handlers.disappear != NULL) {
+    window->handlers.disappear(window);
+  }
+}
+
+// Menu layer
+
+static uint16_t menu_number_of_sections(MenuLayer *menu_layer) {
+  if (menu_layer->callbacks.get_num_sections == NULL) {
+    return 1;
+  }
+  return menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context);
+}
+
+static uint16_t menu_number_of_rows(MenuLayer *menu_layer, uint16_t section) {
+  return menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->context);
+}
+
+static int16_t menu_header_height(MenuLayer *menu_layer, uint16_t section) {
+  if (menu_layer->callbacks.get_header_height == NULL) {
+    return 0;
+  }
+  return menu_layer->callbacks.get_header_height(menu_layer, section, menu_layer->context);
+}
+
+static int16_t menu_cell_height(MenuLayer *menu_layer, MenuIndex *index) {
+  if (menu_layer->callbacks.get_cell_height == NULL) {
+    return MENU_CELL_HEIGHT;
+  }
+  return menu_layer->callbacks.get_cell_height(menu_layer, index, menu_layer->context);
+}
+
+// Walks the cells in order, drawing those between top and bottom when asked,
+// and returns the top of the selected cell
+static int menu_walk(MenuLayer *menu_layer, GContext *ctx, int top, int bottom, bool should_draw) {
+  Layer cell_layer;
+  int y = 0;
+  int selected_y = 0;
+
+  uint16_t number_of_sections = menu_number_of_sections(menu_layer);
+  for (uint16_t section = 0; section < number_of_sections && y < bottom; section++) {
+    int16_t header_height = menu_header_height(menu_layer, section);
+    if (header_height > 0) {
+      if (should_draw && y + header_height > top && menu_layer->callbacks.draw_header != NULL) {
+        init_layer(&cell_layer, PlainLayerKind, GRect(0, y - top, menu_layer->layer.frame.size.w, header_height));
+        menu_layer->callbacks.draw_header(ctx, &cell_layer, section, menu_layer->context);
+      }
+      y += header_height;
+    }
+
+    uint16_t number_of_rows = menu_number_of_rows(menu_layer, section);
+    for (uint16_t row = 0; row < number_of_rows && y < bottom; row++) {
+      MenuIndex index = { .section = section, .row = row };
+      int16_t height = menu_cell_height(menu_layer, &index);
+      if (section == menu_layer->selected_index.section && row == menu_layer->selected_index.row) {
+        selected_y = y;
+      }
+      if (should_draw && y + height > top) {
+        init_layer(&cell_layer, PlainLayerKind, GRect(0, y - top, menu_layer->layer.frame.size.w, height));
+        menu_layer->callbacks.draw_row(ctx, &cell_layer, &index, menu_layer->context);
+      }
+      y += height;
+    }
+  }
+
+  return selected_y;
+}
+
+// Keeps the selected cell in the middle, like the firmware does
+static void draw_menu(MenuLayer *menu_layer, GContext *ctx) {
+  int height = menu_layer->layer.frame.size.h;
+  MenuIndex *selected_index = &menu_layer->selected_index;
+
+  int selected_y = menu_walk(menu_layer, ctx, 0, INT16_MAX, false);
+  int top = selected_y - (height - menu_cell_height(menu_layer, selected_index)) / 2;
+  if (top < 0) {
+    top = 0;
+  }
+  menu_walk(menu_layer, ctx, top, top + height, true);
+}
+
+static void menu_move_selection(MenuLayer *menu_layer, int direction) {
+  uint16_t number_of_sections = menu_number_of_sections(menu_layer);
+  int section = menu_layer->selected_index.section;
+  int row = menu_layer->selected_index.row + direction;
+
+  while (section >= 0 && section < number_of_sections) {
+    int number_of_rows = menu_number_of_rows(menu_layer, section);
+    if (row >= 0 && row < number_of_rows) {
+      MenuIndex old_index = menu_layer->selected_index;
+      menu_layer->selected_index = (MenuIndex){ .section = section, .row = row };
+      if (menu_layer->callbacks.selection_changed != NULL) {
+        menu_layer->callbacks.selection_changed(menu_layer, menu_layer->selected_index, old_index, menu_layer->context);
+      }
+      is_dirty = true;
+      return;
+    }
+
+    section += direction;
+    if (section >= 0 && section < number_of_sections) {
+      row = direction > 0 ? 0 : menu_number_of_rows(menu_layer, section) - 1;
+    }
+  }
+}
+
+static void menu_up_handler(ClickRecognizerRef recognizer, void *context) {
+  menu_move_selection(context, -1);
+}
+
+static void menu_down_handler(ClickRecognizerRef recognizer, void *context) {
+  menu_move_selection(context, 1);
+}
+
+static void menu_select_handler(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = context;
+  if (menu_layer->callbacks.select_click != NULL) {
+    menu_layer->callbacks.select_click(menu_layer, &menu_layer->selected_index, menu_layer->context);
+  }
+}
+
+static void menu_click_config_provider(void *context) {
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, 100, menu_up_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, menu_down_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, menu_select_handler);
+}
+
+// Scroll layer
+
+static void scroll_by(ScrollLayer *scroll_layer, int delta) {
+  int max_offset = scroll_layer->content_size.h - scroll_layer->layer.frame.size.h;
+  int offset = scroll_layer->content_offset + delta;
+  if (offset > max_offset) {
+    offset = max_offset;
+  }
+  if (offset < 0) {
+    offset = 0;
+  }
+  scroll_layer->content_offset = offset;
+  if (scroll_layer->callbacks.content_offset_changed_handler != NULL) {
+    scroll_layer->callbacks.content_offset_changed_handler(scroll_layer, NULL);
+  }
+  is_dirty = true;
+}
+
+static void scroll_up_handler(ClickRecognizerRef recognizer, void *context) {
+  scroll_by(context, -SCROLL_STEP);
+}
+
+static void scroll_down_handler(ClickRecognizerRef recognizer, void *context) {
+  scroll_by(context, SCROLL_STEP);
+}
+
+static void scroll_click_config_provider(void *context) {
+  ScrollLayer *scroll_layer = context;
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, 100, scroll_up_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, scroll_down_handler);
+  if (scroll_layer->callbacks.click_config_provider != NULL) {
+    scroll_layer->callbacks.click_config_provider(NULL);
+  }
+}
+
+// Drawing
+
+static void draw_layer(Layer *layer, GContext *ctx) {
+  if (layer->hidden) {
+    return;
+  }
+
+  if (layer->update_proc != NULL) {
+    layer->update_proc(layer, ctx);
+  }
+  if (layer->kind == MenuLayerKind) {
+    draw_menu((MenuLayer *)layer, ctx);
+  }
+
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    draw_layer(child, ctx);
+  }
+}
+
+// Timers and ticks
+
+static void insert_timer(AppTimer *timer) {
+  AppTimer **link = &timers;
+  while (*link != NULL && (*link)->fire_time_ms <= timer->fire_time_ms) {
+    link = &(*link)->next;
+  }
+  timer->next = *link;
+  *link = timer;
+}
+
+static bool unlink_timer(AppTimer *timer) {
+  for (AppTimer **link = &timers; *link != NULL; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Every unit above a second changes on a minute boundary, so nothing coarser
+// needs waking up more often than that
+static uint64_t next_tick_ms() {
+  if (tick_handler == NULL) {
+    return UINT64_MAX;
+  }
+  if (tick_units & SECOND_UNIT) {
+    return (now_ms / 1000 + 1) * 1000;
+  }
+  return (now_ms / 60000 + 1) * 60000;
+}
+
+static void fire_tick() {
+  time_t now = now_ms / 1000;
+  struct tm tick_time;
+  struct tm last_time;
+  localtime_r(&now, &tick_time);
+  localtime_r(&last_tick_time, &last_time);
+
+  TimeUnits units_changed = SECOND_UNIT;
+  if (tick_time.tm_min != last_time.tm_min || now - last_tick_time >= 60) {
+    units_changed |= MINUTE_UNIT;
+  }
+  if (tick_time.tm_hour != last_time.tm_hour || now - last_tick_time >= 60 * 60) {
+    units_changed |= HOUR_UNIT;
+  }
+  if (tick_time.tm_yday != last_time.tm_yday || tick_time.tm_year != last_time.tm_year) {
+    units_changed |= DAY_UNIT;
+  }
+  last_tick_time = now;
+
+  if ((units_changed & tick_units) != 0) {
+    tick_handler(&tick_time, units_changed);
+  }
+}
+
+// Persist
+
+// The watch blocks on flash, so its cost goes on the clock as well as in the
+// counts
+static void charge_flash(uint32_t cost_us) {
+  harness_counts.flash_stall_us += cost_us;
+  stall_remainder_us += cost_us;
+  now_ms += stall_remainder_us / 1000;
+  stall_remainder_us %= 1000;
+}
+
+static PersistValue *find_persist_value(uint32_t key) {
+  for (int i = 0; i < number_of_persist_values; i++) {
+    if (persist_values[i].key == key) {
+      return &persist_values[i];
+    }
+  }
+  return NULL;
+}
+
+// AppMessage
+static void begin_dictionary(DictionaryIterator *iterator, uint32_t capacity) {
+  iterator->capacity = capacity < APP_MESSAGE_SIZE_MAXIMUM ? capacity : APP_MESSAGE_SIZE_MAXIMUM;
+  iterator->size = 1;
+  iterator->buffer[0] = 0;
+}
+
+static DictionaryResult write_tuple(DictionaryIterator *iterator, uint32_t key, TupleType type, const void *value, uint16_t length) {
+  if (iterator->size + TUPLE_HEADER_SIZE + length > iterator->capacity) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+
+  Tuple *tuple = (Tuple *)&iterator->buffer[iterator->size];
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value, value, length);
+  iterator->size += TUPLE_HEADER_SIZE + length;
+  iterator->buffer[0]++;
+  return DICT_OK;
+}
+
+// Harness functions
+time_t harness_time(time_t *tloc) {
+  time_t now = now_ms / 1000;
+  if (tloc != NULL) {
+    *tloc = now;
+  }
+  return now;
+}
+
+void harness_set_time(time_t time) {
+  now_ms = (uint64_t)time * 1000;
+  last_tick_time = time;
+}
+
+uint64_t harness_now_ms() {
+  return now_ms;
+}
+
+void harness_name_windows(const char *name) {
+  for (int i = 0; i < number_of_windows; i++) {
+    if (windows[i]->name == NULL) {
+      windows[i]->name = name;
+    }
+  }
+}
+
+void harness_set_flash_model(FlashModel model) {
+  if (model.max_value_size > PERSIST_DATA_MAX_LENGTH) {
+    model.max_value_size = PERSIST_DATA_MAX_LENGTH;
+  }
+  flash_model = model;
+}
+
+FlashModel harness_flash_model() {
+  return flash_model;
+}
+
+int harness_storage_used() {
+  return storage_used;
+}
+
+int harness_number_of_persist_keys() {
+  return number_of_persist_values;
+}
+
+void harness_clear_persist() {
+  number_of_persist_values = 0;
+  storage_used = 0;
+}
+
+const char *harness_top_window_name() {
+  Window *window = top_window();
+  return window != NULL && window->name != NULL ? window->name : "-";
+}
+
+bool harness_click(ButtonId button, uint8_t clicks_counted) {
+  Window *window = top_window();
+  if (window == NULL) {
+    return false;
+  }
+
+  ClickSubscription *subscription = &window->clicks[button];
+  if (subscription->handler == NULL) {
+    // Back pops the window unless the app takes it over
+    if (button == BUTTON_ID_BACK && clicks_counted == 1) {
+      window_stack_pop(true);
+      return true;
+    }
+    return false;
+  }
+  if (clicks_counted > 1 && subscription->repeat_interval_ms == 0) {
+    return false;
+  }
+
+  ClickRecognizer recognizer = {
+    .button = button,
+    .clicks_counted = clicks_counted,
+    .is_repeating = clicks_counted > 1,
+  };
+  subscription->handler(&recognizer, window->click_config_context);
+  return true;
+}
+
+bool harness_long_click(ButtonId button) {
+  Window *window = top_window();
+  if (window == NULL || window->clicks[button].long_handler == NULL) {
+    return false;
+  }
+
+  ClickRecognizer recognizer = {
+    .button = button,
+    .clicks_counted = 1,
+  };
+  window->clicks[button].long_handler(&recognizer, window->click_config_context);
+  return true;
+}
+
+uint16_t harness_repeat_interval(ButtonId button) {
+  Window *window = top_window();
+  return window != NULL ? window->clicks[button].repeat_interval_ms : 0;
+}
+
+bool harness_run_next_event(uint64_t until_ms, const char **label) {
+  uint64_t tick_ms = next_tick_ms();
+  if (timers != NULL && timers->fire_time_ms <= until_ms && timers->fire_time_ms <= tick_ms) {
+    AppTimer *timer = timers;
+    timers = timer->next;
+    if (timer->fire_time_ms > now_ms) {
+      now_ms = timer->fire_time_ms;
+    }
+    *label = "timer";
+    AppTimerCallback callback = timer->callback;
+    void *data = timer->data;
+    free(timer);
+    callback(data);
+    return true;
+  }
+
+  if (tick_ms <= until_ms) {
+    now_ms = tick_ms;
+    *label = "tick";
+    fire_tick();
+    return true;
+  }
+
+  if (until_ms > now_ms) {
+    now_ms = until_ms;
+  }
+  return false;
+}
+
+const DictionaryIterator *harness_outbox_message() {
+  return outbox_is_pending ? &outbox : NULL;
+}
+
+void harness_finish_outbox(bool delivered) {
+  if (!outbox_is_pending) {
+    return;
+  }
+
+  outbox_is_pending = false;
+  if (delivered && is_connected) {
+    if (outbox_sent_callback != NULL) {
+      outbox_sent_callback(&outbox, NULL);
+    }
+  } else if (outbox_failed_callback != NULL) {
+    outbox_failed_callback(&outbox, is_connected ? APP_MSG_SEND_TIMEOUT : APP_MSG_NOT_CONNECTED, NULL);
+  }
+}
+
+DictionaryIterator *harness_inbox_begin() {
+  begin_dictionary(&inbox, inbox_size);
+  return &inbox;
+}
+
+// Dropped, as on the watch, unless the app has opened AppMessage
+void harness_inbox_send() {
+  if (inbox_size > 0 && inbox_received_callback != NULL) {
+    inbox_received_callback(&inbox, NULL);
+  }
+}
+
+void harness_set_connected(bool connected) {
+  is_connected = connected;
+  if (connection_handler != NULL) {
+    connection_handler(connected);
+  }
+}
+
+bool harness_render_if_dirty() {
+  unload_popped_windows();
+
+  Window *window = top_window();
+  if (!is_dirty || window == NULL) {
+    return false;
+  }
+
+  is_dirty = false;
+  GContext ctx = { 0 };
+  draw_layer(&window->root_layer, &ctx);
+  return true;
+}
+
+// Non-static functions
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (getenv("HARNESS_LOG") == NULL) {
+    return;
+  }
+
+  va_list arguments;
+  va_start(arguments, fmt);
+  fprintf(stderr, "%s:%d ", src_filename, src_line_number);
+  vfprintf(stderr, fmt, arguments);
+  fputc('\n', stderr);
+  va_end(arguments);
+}
+
+bool clock_is_24h_style() {
+  return true;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  if (tloc != NULL) {
+    *tloc = now_ms / 1000;
+  }
+  if (out_ms != NULL) {
+    *out_ms = now_ms % 1000;
+  }
+  return now_ms % 1000;
+}
+
+AppLaunchReason launch_reason() {
+  return APP_LAUNCH_USER;
+}
+
+void app_event_loop() {
+}
+
+bool persist_exists(uint32_t key) {
+  charge_flash(flash_model.read_cost_us);
+  harness_counts.persist_reads++;
+  return find_persist_value(key) != NULL;
+}
+
+int persist_get_size(uint32_t key) {
+  charge_flash(flash_model.read_cost_us);
+  harness_counts.persist_reads++;
+  PersistValue *value = find_persist_value(key);
+  return value != NULL ? value->size : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(uint32_t key, void *buffer, size_t buffer_size) {
+  charge_flash(flash_model.read_cost_us);
+  harness_counts.persist_reads++;
+  PersistValue *value = find_persist_value(key);
+  if (value == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  int size = value->size < (int)buffer_size ? value->size : (int)buffer_size;
+  memcpy(buffer, value->data, size);
+  return size;
+}
+
+bool persist_read_bool(uint32_t key) {
+  bool value = false;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int32_t persist_read_int(uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+// Values over the size limit are cut short, as the SDK does; a write that
+// would go over the storage budget fails and leaves the old value
+int persist_write_data(uint32_t key, const void *data, size_t size) {
+  charge_flash(flash_model.write_cost_us);
+  harness_counts.persist_writes++;
+  if (size > flash_model.max_value_size) {
+    size = flash_model.max_value_size;
+  }
+
+  PersistValue *value = find_persist_value(key);
+  int old_size = value != NULL ? value->size : 0;
+  if (storage_used - old_size + (int)size > (int)flash_model.storage_budget ||
+      (value == NULL && number_of_persist_values == MAX_NUMBER_OF_PERSIST_KEYS)) {
+    harness_counts.persist_failures++;
+    return E_OUT_OF_STORAGE;
+  }
+
+  if (value == NULL) {
+    value = &persist_values[number_of_persist_values++];
+    value->key = key;
+  }
+
+  storage_used += size - old_size;
+  value->size = size;
+  memcpy(value->data, data, size);
+  return size;
+}
+
+status_t persist_write_bool(uint32_t key, bool value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+status_t persist_write_int(uint32_t key, int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+status_t persist_delete(uint32_t key) {
+  charge_flash(flash_model.delete_cost_us);
+  harness_counts.persist_deletes++;
+  PersistValue *value = find_persist_value(key);
+  if (value == NULL) {
+    return E_DOES_NOT_EXIST;
+  }
+
+  storage_used -= value->size;
+  *value = persist_values[--number_of_persist_values];
+  return S_SUCCESS;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  AppTimer *timer = calloc(1, sizeof(AppTimer));
+  timer->fire_time_ms = now_ms + timeout_ms;
+  timer->callback = callback;
+  timer->data = callback_data;
+  insert_timer(timer);
+  return timer;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  if (!unlink_timer(timer_handle)) {
+    return false;
+  }
+  timer_handle->fire_time_ms = now_ms + new_timeout_ms;
+  insert_timer(timer_handle);
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  if (unlink_timer(timer_handle)) {
+    free(timer_handle);
+  }
+}
+
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler) {
+  tick_units = units;
+  tick_handler = handler;
+  last_tick_time = now_ms / 1000;
+}
+
+void tick_timer_service_unsubscribe() {
+  tick_units = 0;
+  tick_handler = NULL;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  subscribe_click(button_id, 0, handler);
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler) {
+  subscribe_click(button_id, repeat_interval_ms, handler);
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler) {
+  if (configuring_window != NULL) {
+    configuring_window->clicks[button_id].long_handler = down_handler;
+  }
+}
+
+void window_raw_click_subscribe(ButtonId button_id, ClickHandler down_handler, ClickHandler up_handler, void *context) {
+}
+
+uint8_t click_number_of_clicks_counted(ClickRecognizerRef recognizer) {
+  return ((ClickRecognizer *)recognizer)->clicks_counted;
+}
+
+bool click_recognizer_is_repeating(ClickRecognizerRef recognizer) {
+  return ((ClickRecognizer *)recognizer)->is_repeating;
+}
+
+Window *window_create() {
+  Window *window = calloc(1, sizeof(Window));
+  init_layer(&window->root_layer, PlainLayerKind, GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT));
+  if (number_of_windows < MAX_NUMBER_OF_WINDOWS) {
+    windows[number_of_windows++] = window;
+  }
+  return window;
+}
+
+void window_destroy(Window *window) {
+  for (int i = 0; i < number_of_windows; i++) {
+    if (windows[i] == window) {
+      windows[i] = windows[--number_of_windows];
+      break;
+    }
+  }
+  free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root_layer;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider provider) {
+  window_set_click_config_provider_with_context(window, provider, NULL);
+}
+
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider provider, void *context) {
+  window->click_config_provider = provider;
+  window->click_config_context = context;
+  if (window == top_window()) {
+    configure_clicks(window);
+  }
+}
+
+void window_stack_push(Window *window, bool animated) {
+  Window *previous_window = top_window();
+  if (previous_window == window) {
+    return;
+  }
+  if (previous_window != NULL) {
+    disappear(previous_window);
+  }
+
+  // A window already on the stack moves to the top without reloading
+  for (int i = 0; i < window_stack_size; i++) {
+    if (window_stack[i] == window) {
+      memmove(&window_stack[i], &window_stack[i + 1], (window_stack_size - i - 1) * sizeof(Window *));
+      window_stack_size--;
+      break;
+    }
+  }
+  if (window_stack_size == MAX_WINDOW_STACK_SIZE) {
+    return;
+  }
+
+  cancel_unload(window);
+  window_stack[window_stack_size++] = window;
+  if (!window->is_loaded) {
+    window->is_loaded = true;
+    if (window->handlers.load != NULL) {
+      window->handlers.load(window);
+    }
+  }
+  appear(window);
+}
+
+Window *window_stack_pop(bool animated) {
+  Window *window = top_window();
+  if (window == NULL) {
+    return NULL;
+  }
+
+  disappear(window);
+  window_stack_size--;
+  if (number_of_windows_to_unload < MAX_WINDOW_STACK_SIZE) {
+    windows_to_unload[number_of_windows_to_unload++] = window;
+  }
+
+  Window *next_window = top_window();
+  if (next_window != NULL) {
+    appear(next_window);
+  }
+  return window;
+}
+
+bool window_stack_contains_window(Window *window) {
+  for (int i = 0; i < window_stack_size; i++) {
+    if (window_stack[i] == window) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Window *window_stack_get_top_window() {
+  return top_window();
+}
+
+void window_stack_pop_all(bool animated) {
+  while (window_stack_size > 0) {
+    window_stack_pop(animated);
+  }
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = malloc(sizeof(Layer));
+  init_layer(layer, PlainLayerKind, frame);
+  return layer;
+}
+
+void layer_destroy(Layer *layer) {
+  remove_from_parent(layer);
+  free(layer);
+}
+
+void layer_mark_dirty(Layer *layer) {
+  is_dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  remove_from_parent(child);
+  child->parent = parent;
+
+  Layer **link = &parent->first_child;
+  while (*link != NULL) {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  is_dirty = true;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden != hidden) {
+    layer->hidden = hidden;
+    is_dirty = true;
+  }
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = calloc(1, sizeof(TextLayer));
+  init_layer(&text_layer->layer, TextLayerKind, frame);
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  remove_from_parent(&text_layer->layer);
+  free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  is_dirty = true;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment) {
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+  return (GFont)font_key;
+}
+
+MenuLayer *menu_layer_create(GRect frame) {
+  MenuLayer *menu_layer = calloc(1, sizeof(MenuLayer));
+  init_layer(&menu_layer->layer, MenuLayerKind, frame);
+  return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  remove_from_parent(&menu_layer->layer);
+  free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer *)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->context = callback_context;
+  is_dirty = true;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+  window_set_click_config_provider_with_context(window, menu_click_config_provider, menu_layer);
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+  // The selection stays where it was as long as it still exists
+  uint16_t number_of_sections = menu_number_of_sections(menu_layer);
+  MenuIndex *index = &menu_layer->selected_index;
+  if (index->section >= number_of_sections || index->row >= menu_number_of_rows(menu_layer, index->section)) {
+    *index = (MenuIndex){ 0, 0 };
+  }
+  is_dirty = true;
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+  return menu_layer->selected_index;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle, GBitmap *icon) {
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+}
+
+void menu_cell_title_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+}
+
+ScrollLayer *scroll_layer_create(GRect frame) {
+  ScrollLayer *scroll_layer = calloc(1, sizeof(ScrollLayer));
+  init_layer(&scroll_layer->layer, ScrollLayerKind, frame);
+  return scroll_layer;
+}
+
+void scroll_layer_destroy(ScrollLayer *scroll_layer) {
+  remove_from_parent(&scroll_layer->layer);
+  free(scroll_layer);
+}
+
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer) {
+  return (Layer *)&scroll_layer->layer;
+}
+
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child) {
+  layer_add_child(&scroll_layer->layer, child);
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window) {
+  window_set_click_config_provider_with_context(window, scroll_click_config_provider, scroll_layer);
+}
+
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks) {
+  scroll_layer->callbacks = callbacks;
+}
+
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size) {
+  scroll_layer->content_size = size;
+}
+
+ActionBarLayer *action_bar_layer_create() {
+  ActionBarLayer *action_bar = calloc(1, sizeof(ActionBarLayer));
+  init_layer(&action_bar->layer, ActionBarLayerKind, GRect(SCREEN_WIDTH - ACTION_BAR_WIDTH, 0, ACTION_BAR_WIDTH, SCREEN_HEIGHT));
+  return action_bar;
+}
+
+void action_bar_layer_destroy(ActionBarLayer *action_bar) {
+  remove_from_parent(&action_bar->layer);
+  free(action_bar);
+}
+
+Layer *action_bar_layer_get_layer(ActionBarLayer *action_bar) {
+  return &action_bar->layer;
+}
+
+void action_bar_layer_add_to_window(ActionBarLayer *action_bar, Window *window) {
+  action_bar->window = window;
+  layer_add_child(window_get_root_layer(window), &action_bar->layer);
+  if (action_bar->click_config_provider != NULL) {
+    window_set_click_config_provider(window, action_bar->click_config_provider);
+  }
+}
+
+void action_bar_layer_set_click_config_provider(ActionBarLayer *action_bar, ClickConfigProvider click_config_provider) {
+  action_bar->click_config_provider = click_config_provider;
+  if (action_bar->window != NULL) {
+    window_set_click_config_provider(action_bar->window, click_config_provider);
+  }
+}
+
+void action_bar_layer_set_icon(ActionBarLayer *action_bar, ButtonId button_id, const GBitmap *icon) {
+  is_dirty = true;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  return gbitmap_create_blank(GSize(ACTION_BAR_WIDTH - 2, ACTION_BAR_WIDTH - 2), GBitmapFormat1Bit);
+}
+
+// Only the 1-bit format, the one the app draws into
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  if (format != GBitmapFormat1Bit) {
+    return NULL;
+  }
+
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->size = size;
+  bitmap->bytes_per_row = ((size.w + 31) / 32) * 4;
+  bitmap->data = calloc(bitmap->bytes_per_row * size.h + 1, 1);
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap != NULL) {
+    free(bitmap->data);
+    free(bitmap);
+  }
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->bytes_per_row;
+}
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = calloc(1, sizeof(BitmapLayer));
+  init_layer(&bitmap_layer->layer, BitmapLayerKind, frame);
+  return bitmap_layer;
+}
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  remove_from_parent(&bitmap_layer->layer);
+  free(bitmap_layer);
+}
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *)&bitmap_layer->layer;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  is_dirty = true;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, void *layout) {
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size) {
+  return write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return write_tuple(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return write_tuple(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  return iter->size;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  uint32_t offset = 1;
+  for (int i = 0; i < iter->buffer[0]; i++) {
+    Tuple *tuple = (Tuple *)&iter->buffer[offset];
+    if (tuple->key == key) {
+      return tuple;
+    }
+    offset += TUPLE_HEADER_SIZE + tuple->length;
+  }
+  return NULL;
+}
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+  uint32_t size = 1 + tuple_count * TUPLE_HEADER_SIZE;
+  va_list sizes;
+  va_start(sizes, tuple_count);
+  for (int i = 0; i < tuple_count; i++) {
+    size += va_arg(sizes, uint32_t);
+  }
+  va_end(sizes);
+  return size;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (size_inbound > APP_MESSAGE_SIZE_MAXIMUM || size_outbound > APP_MESSAGE_SIZE_MAXIMUM) {
+    return APP_MSG_BUFFER_OVERFLOW;
+  }
+  inbox_size = size_inbound;
+  outbox_size = size_outbound;
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum() {
+  return APP_MESSAGE_SIZE_MAXIMUM;
+}
+
+uint32_t app_message_outbox_size_maximum() {
+  return APP_MESSAGE_SIZE_MAXIMUM;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived old_callback = inbox_received_callback;
+  inbox_received_callback = received_callback;
+  return old_callback;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent old_callback = outbox_sent_callback;
+  outbox_sent_callback = sent_callback;
+  return old_callback;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed old_callback = outbox_failed_callback;
+  outbox_failed_callback = failed_callback;
+  return old_callback;
+}
+
+// Closes AppMessage too, so a message still in the outbox is never finished
+void app_message_deregister_callbacks() {
+  inbox_received_callback = NULL;
+  outbox_sent_callback = NULL;
+  outbox_failed_callback = NULL;
+  inbox_size = 0;
+  outbox_size = 0;
+  outbox_is_pending = false;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (outbox_size == 0) {
+    return APP_MSG_INVALID_STATE;
+  }
+  if (outbox_is_pending) {
+    return APP_MSG_BUSY;
+  }
+
+  begin_dictionary(&outbox, outbox_size);
+  *iterator = &outbox;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send() {
+  if (outbox_size == 0 || outbox_is_pending) {
+    return APP_MSG_BUSY;
+  }
+  if (!is_connected) {
+    return APP_MSG_NOT_CONNECTED;
+  }
+
+  outbox_is_pending = true;
+  return APP_MSG_OK;
+}
+
+// The phone runs the Pebble app and no PebbleKit app of its own
+void connection_service_subscribe(ConnectionHandlers conn_handlers) {
+  connection_handler = conn_handlers.pebble_app_connection_handler;
+}
+
+void connection_service_unsubscribe() {
+  connection_handler = NULL;
+}
+
+bool connection_service_peek_pebble_app_connection() {
+  return is_connected;
+}
+
+bool connection_service_peek_pebblekit_connection() {
+  return false;
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_file.h"
+#include "log_format.h"
+#include "summary_math.h"
+
+// Static functions
+static size_t align4(size_t size) {
+  return (size + 3) & ~(size_t)3;
+}
+
+static bool is_little_endian() {
+  const uint16_t one = 1;
+  return *(const uint8_t *)&one == 1;
+}
+
+static const uint8_t *session_bytes(const LogFile *file, uint32_t index) {
+  return file->bytes + log_read_uint32(file->bytes + LOG_HEADER_SESSIONS_OFFSET) + index * LOG_SESSION_SIZE;
+}
+
+static bool section_fits(size_t size, uint32_t offset, uint64_t length) {
+  return offset % 4 == 0 && offset <= size && length <= size - offset;
+}
+
+// Non-static functions
+bool log_file_is_log(const uint8_t *bytes, size_t size) {
+  return size >= 4 && memcmp(bytes, LOG_FILE_MAGIC, 4) == 0;
+}
+
+size_t log_file_size(uint32_t count, uint32_t number_of_sessions) {
+  return LOG_FILE_HEADER_SIZE + number_of_sessions * LOG_SESSION_SIZE + count * sizeof(uint32_t) + align4(count * sizeof(uint16_t));
+}
+
+uint32_t log_file_count_sessions(const uint32_t *start_times, const uint16_t *durations, uint32_t count) {
+  uint32_t number_of_sessions = 0;
+  for (uint32_t first = 0; first < count; number_of_sessions++) {
+    first += summary_newest_session_length(&start_times[first], &durations[first], count - first);
+  }
+  return number_of_sessions;
+}
+
+size_t log_file_encode(uint8_t *bytes, const uint32_t *start_times, const uint16_t *durations, uint32_t count, uint32_t sync_sequence) {
+  uint32_t number_of_sessions = log_file_count_sessions(start_times, durations, count);
+  size_t size = log_file_size(count, number_of_sessions);
+  uint32_t sessions_offset = LOG_FILE_HEADER_SIZE;
+  uint32_t start_times_offset = sessions_offset + number_of_sessions * LOG_SESSION_SIZE;
+  uint32_t durations_offset = start_times_offset + count * sizeof(uint32_t);
+
+  memset(bytes, 0, size);
+  memcpy(bytes, LOG_FILE_MAGIC, 4);
+  log_write_uint16(bytes + LOG_HEADER_VERSION_OFFSET, LOG_FILE_VERSION);
+  log_write_uint16(bytes + LOG_HEADER_SIZE_OFFSET, LOG_FILE_HEADER_SIZE);
+  log_write_uint32(bytes + LOG_HEADER_COUNT_OFFSET, count);
+  log_write_uint32(bytes + LOG_HEADER_SESSION_COUNT_OFFSET, number_of_sessions);
+  log_write_uint32(bytes + LOG_HEADER_SEQUENCE_OFFSET, sync_sequence);
+  log_write_uint32(bytes + LOG_HEADER_SESSIONS_OFFSET, sessions_offset);
+  log_write_uint32(bytes + LOG_HEADER_START_TIMES_OFFSET, start_times_offset);
+  log_write_uint32(bytes + LOG_HEADER_DURATIONS_OFFSET, durations_offset);
+  log_write_uint32(bytes + LOG_HEADER_FILE_SIZE_OFFSET, size);
+
+  uint8_t *session = bytes + sessions_offset;
+  for (uint32_t first = 0; first < count;) {
+    uint32_t length = summary_newest_session_length(&start_times[first], &durations[first], count - first);
+    session = log_write_uint32(session, first);
+    session = log_write_uint32(session, length);
+    session = log_write_uint32(session, start_times[first + length - 1]);
+    session = log_write_uint32(session, start_times[first] + durations[first]);
+    session = log_write_uint32(session, summary_sum_durations(&durations[first], length));
+    session = log_write_uint32(session, summary_total_interval(&start_times[first], length));
+    first += length;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    log_write_uint32(bytes + start_times_offset + i * sizeof(uint32_t), start_times[i]);
+    log_write_uint16(bytes + durations_offset + i * sizeof(uint16_t), durations[i]);
+  }
+
+  return size;
+}
+
+int log_file_write(const char *path, const uint32_t *start_times, const uint16_t *durations, uint32_t count, uint32_t sync_sequence) {
+  size_t size = log_file_size(count, log_file_count_sessions(start_times, durations, count));
+  uint8_t *bytes = malloc(size);
+  if (bytes == NULL) {
+    return ENOMEM;
+  }
+  log_file_encode(bytes, start_times, durations, count, sync_sequence);
+
+  int error = 0;
+  FILE *stream = fopen(path, "wb");
+  if (stream == NULL) {
+    error = errno;
+  } else {
+    if (fwrite(bytes, 1, size, stream) != size) {
+      error = EIO;
+    }
+    if (fclose(stream) != 0 && error == 0) {
+      error = errno;
+    }
+  }
+
+  free(bytes);
+  return error;
+}
+
+// Checks the header and that every section lies inside the file; the
+// columns themselves are trusted, so opening a log costs the same at any size
+int log_file_parse(LogFile *file, const uint8_t *bytes, size_t size) {
+  memset(file, 0, sizeof(*file));
+  if (size < LOG_FILE_HEADER_SIZE || !log_file_is_log(bytes, size) ||
+      log_read_uint16(bytes + LOG_HEADER_VERSION_OFFSET) != LOG_FILE_VERSION ||
+      log_read_uint16(bytes + LOG_HEADER_SIZE_OFFSET) < LOG_FILE_HEADER_SIZE ||
+      log_read_uint32(bytes + LOG_HEADER_FILE_SIZE_OFFSET) != size) {
+    return EINVAL;
+  }
+
+  uint32_t count = log_read_uint32(bytes + LOG_HEADER_COUNT_OFFSET);
+  uint32_t number_of_sessions = log_read_uint32(bytes + LOG_HEADER_SESSION_COUNT_OFFSET);
+  uint32_t start_times_offset = log_read_uint32(bytes + LOG_HEADER_START_TIMES_OFFSET);
+  uint32_t durations_offset = log_read_uint32(bytes + LOG_HEADER_DURATIONS_OFFSET);
+  if (!section_fits(size, log_read_uint32(bytes + LOG_HEADER_SESSIONS_OFFSET), (uint64_t)number_of_sessions * LOG_SESSION_SIZE) ||
+      !section_fits(size, start_times_offset, (uint64_t)count * sizeof(uint32_t)) ||
+      !section_fits(size, durations_offset, (uint64_t)count * sizeof(uint16_t)) ||
+      (number_of_sessions == 0) != (count == 0)) {
+    return EINVAL;
+  }
+
+  file->bytes = bytes;
+  file->size = size;
+  file->count = count;
+  file->number_of_sessions = number_of_sessions;
+  file->sync_sequence = log_read_uint32(bytes + LOG_HEADER_SEQUENCE_OFFSET);
+
+  uint32_t end = 0;
+  for (uint32_t i = 0; i < number_of_sessions; i++) {
+    LogSession session;
+    log_file_session(file, i, &session);
+    if (session.first_index != end || session.count == 0 || session.count > count - end) {
+      memset(file, 0, sizeof(*file));
+      return EINVAL;
+    }
+    end += session.count;
+  }
+  if (end != count) {
+    memset(file, 0, sizeof(*file));
+    return EINVAL;
+  }
+
+  if (is_little_endian() && ((uintptr_t)(bytes + start_times_offset) | (uintptr_t)(bytes + durations_offset)) % 4 == 0) {
+    file->start_times = (const uint32_t *)(bytes + start_times_offset);
+    file->durations = (const uint16_t *)(bytes + durations_offset);
+  }
+  return 0;
+}
+
+int log_file_map(LogFile *file, const char *path) {
+  memset(file, 0, sizeof(*file));
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return errno;
+  }
+
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    int error = errno;
+    close(descriptor);
+    return error;
+  }
+  if (status.st_size < LOG_FILE_HEADER_SIZE) {
+    close(descriptor);
+    return EINVAL;
+  }
+
+  void *bytes = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  int error = bytes == MAP_FAILED ? errno : 0;
+  close(descriptor);
+  if (error != 0) {
+    return error;
+  }
+
+  error = log_file_parse(file, bytes, status.st_size);
+  if (error != 0) {
+    munmap(bytes, status.st_size);
+    return error;
+  }
+  file->is_mapped = true;
+  return 0;
+}
+
+void log_file_unmap(LogFile *file) {
+  if (file->is_mapped) {
+    munmap((void *)file->bytes, file->size);
+  }
+  memset(file, 0, sizeof(*file));
+}
+
+uint32_t log_file_start_time(const LogFile *file, uint32_t index) {
+  if (file->start_times != NULL) {
+    return file->start_times[index];
+  }
+  return log_read_uint32(file->bytes + log_read_uint32(file->bytes + LOG_HEADER_START_TIMES_OFFSET) + index * sizeof(uint32_t));
+}
+
+uint16_t log_file_duration(const LogFile *file, uint32_t index) {
+  if (file->durations != NULL) {
+    return file->durations[index];
+  }
+  return log_read_uint16(file->bytes + log_read_uint32(file->bytes + LOG_HEADER_DURATIONS_OFFSET) + index * sizeof(uint16_t));
+}
+
+void log_file_session(const LogFile *file, uint32_t index, LogSession *session) {
+  const uint8_t *bytes = session_bytes(file, index);
+  session->first_index = log_read_uint32(bytes);
+  session->count = log_read_uint32(bytes + 4);
+  session->start_time = log_read_uint32(bytes + 8);
+  session->end_time = log_read_uint32(bytes + 12);
+  session->total_duration_in_seconds = log_read_uint32(bytes + 16);
+  session->total_interval_in_seconds = log_read_uint32(bytes + 20);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host reader and writer for the log file described in src/log_format.h
+
+typedef struct {
+  uint32_t first_index;
+  uint32_t count;
+  uint32_t start_time;
+  uint32_t end_time;
+  uint32_t total_duration_in_seconds;
+  uint32_t total_interval_in_seconds;
+} LogSession;
+
+typedef struct {
+  const uint8_t *bytes;
+  size_t size;
+  bool is_mapped;
+
+  uint32_t count;
+  uint32_t number_of_sessions;
+  uint32_t sync_sequence;
+
+  // The columns in place, or NULL on a big-endian host; use the accessors
+  // below then
+  const uint32_t *start_times;
+  const uint16_t *durations;
+} LogFile;
+
+bool log_file_is_log(const uint8_t *bytes, size_t size);
+
+size_t log_file_size(uint32_t count, uint32_t number_of_sessions);
+uint32_t log_file_count_sessions(const uint32_t *start_times, const uint16_t *durations, uint32_t count);
+// Columns sorted newest first; bytes must hold log_file_size() bytes
+size_t log_file_encode(uint8_t *bytes, const uint32_t *start_times, const uint16_t *durations, uint32_t count, uint32_t sync_sequence);
+int log_file_write(const char *path, const uint32_t *start_times, const uint16_t *durations, uint32_t count, uint32_t sync_sequence);
+
+// These return 0 or an errno value; EINVAL for a malformed file
+int log_file_parse(LogFile *file, const uint8_t *bytes, size_t size);
+int log_file_map(LogFile *file, const char *path);
+void log_file_unmap(LogFile *file);
+
+uint32_t log_file_start_time(const LogFile *file, uint32_t index);
+uint16_t log_file_duration(const LogFile *file, uint32_t index);
+void log_file_session(const LogFile *file, uint32_t index, LogSession *session);
\ No newline at end of file
@@ -0,0 +1,135 @@
+// Round trip of a log file for "make check".
+//
+//   log_file_check path
+//
+// Writes records in sessions of known sizes to path, then reads them back
+// twice: mapped, with the columns read in place, and parsed from a copy one
+// byte off their alignment, through the accessors. Every record, every
+// session and the sync sequence must come back as written.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_file.h"
+#include "log_format.h"
+
+#define NEWEST_START_TIME 1400000000
+#define SYNC_SEQUENCE 4242
+#define SPACING (5 * 60)
+#define SESSION_GAP (24 * 60 * 60)
+
+// Newest session first; a session of one record has no interval
+static const uint32_t session_lengths[] = { 5, 1, 40, 3, 17 };
+#define NUMBER_OF_SESSIONS (sizeof(session_lengths) / sizeof(session_lengths[0]))
+#define MAX_NUMBER_OF_RECORDS 128
+
+static uint32_t start_times[MAX_NUMBER_OF_RECORDS];
+static uint16_t durations[MAX_NUMBER_OF_RECORDS];
+static LogSession sessions[NUMBER_OF_SESSIONS];
+static uint32_t count;
+static int number_of_failures;
+
+// Static functions
+static void expect(bool condition, const char *how, const char *what, uint32_t index) {
+  if (!condition) {
+    printf("  %s: %s %u differs\n", how, what, index);
+    number_of_failures++;
+  }
+}
+
+// Newest first, with the sessions' totals worked out alongside
+static void make_records() {
+  uint32_t start_time = NEWEST_START_TIME;
+  for (uint32_t i = 0; i < NUMBER_OF_SESSIONS; i++) {
+    LogSession *session = &sessions[i];
+    memset(session, 0, sizeof(*session));
+    session->first_index = count;
+    session->count = session_lengths[i];
+
+    for (uint32_t j = 0; j < session_lengths[i]; j++) {
+      start_times[count] = start_time;
+      durations[count] = 30 + (count * 7) % 60;
+      session->total_duration_in_seconds += durations[count];
+      if (j == 0) {
+        session->end_time = start_time + durations[count];
+      } else {
+        session->total_interval_in_seconds += start_times[count - 1] - start_time;
+      }
+      session->start_time = start_time;
+      count++;
+      start_time -= SPACING;
+    }
+    start_time -= SESSION_GAP;
+  }
+}
+
+static void compare(const LogFile *file, const char *how) {
+  expect(file->count == count, how, "record count", 0);
+  expect(file->number_of_sessions == NUMBER_OF_SESSIONS, how, "session count", 0);
+  expect(file->sync_sequence == SYNC_SEQUENCE, how, "sync sequence", 0);
+  if (file->count != count || file->number_of_sessions != NUMBER_OF_SESSIONS) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    expect(log_file_start_time(file, i) == start_times[i], how, "start time", i);
+    expect(log_file_duration(file, i) == durations[i], how, "duration", i);
+  }
+
+  for (uint32_t i = 0; i < NUMBER_OF_SESSIONS; i++) {
+    LogSession session;
+    log_file_session(file, i, &session);
+    expect(memcmp(&session, &sessions[i], sizeof(session)) == 0, how, "session", i);
+  }
+}
+
+// Non-static functions
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: log_file_check path\n");
+    return 2;
+  }
+
+  make_records();
+  int error = log_file_write(argv[1], start_times, durations, count, SYNC_SEQUENCE);
+  if (error != 0) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(error));
+    return 1;
+  }
+
+  LogFile file;
+  error = log_file_map(&file, argv[1]);
+  if (error != 0) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(error));
+    return 1;
+  }
+  if (file.start_times == NULL) {
+    printf("  mapped: columns not read in place\n");
+    number_of_failures++;
+  }
+  compare(&file, "mapped");
+  size_t size = file.size;
+
+  // The same bytes a byte past a 4-byte boundary
+  uint8_t *buffer = malloc(size + 4);
+  memcpy(buffer + 1, file.bytes, size);
+  log_file_unmap(&file);
+
+  error = log_file_parse(&file, buffer + 1, size);
+  if (error != 0) {
+    fprintf(stderr, "unaligned copy: %s\n", strerror(error));
+    free(buffer);
+    return 1;
+  }
+  if (file.start_times != NULL) {
+    printf("  unaligned: columns read in place\n");
+    number_of_failures++;
+  }
+  compare(&file, "unaligned");
+  free(buffer);
+
+  printf("%s log file round trip: %u records in %u sessions\n", number_of_failures == 0 ? "ok  " : "FAIL", count, (uint32_t)NUMBER_OF_SESSIONS);
+  return number_of_failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+// Converts between exported records and log files.
+//
+//   logpack [-s sequence] records log    pack records into a log file
+//   logpack -d log                       print a log file's sessions and records
+//
+// Records are packed as the watch exports them (see src/log_format.h) and
+// may come in any order; the log file keeps them newest first.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_file.h"
+#include "log_format.h"
+
+typedef struct {
+  uint32_t start_time;
+  uint16_t seconds_elapsed;
+} Record;
+
+// Static functions
+static int compare_newest_first(const void *a, const void *b) {
+  const Record *record_a = a;
+  const Record *record_b = b;
+  return record_a->start_time < record_b->start_time ? 1 : record_a->start_time > record_b->start_time ? -1 : 0;
+}
+
+static int pack(const char *records_path, const char *log_path, uint32_t sync_sequence) {
+  FILE *stream = fopen(records_path, "rb");
+  if (stream == NULL) {
+    perror(records_path);
+    return 1;
+  }
+
+  Record *records = NULL;
+  uint32_t count = 0;
+  uint32_t size = 0;
+  uint8_t bytes[LOG_RECORD_SIZE];
+  while (fread(bytes, 1, LOG_RECORD_SIZE, stream) == LOG_RECORD_SIZE) {
+    if (count == size) {
+      size = size > 0 ? size * 2 : 256;
+      records = realloc(records, size * sizeof(Record));
+    }
+    log_unpack_record(bytes, &records[count].start_time, &records[count].seconds_elapsed);
+    count++;
+  }
+  fclose(stream);
+
+  qsort(records, count, sizeof(Record), compare_newest_first);
+
+  uint32_t *start_times = malloc((count + 1) * sizeof(uint32_t));
+  uint16_t *durations = malloc((count + 1) * sizeof(uint16_t));
+  for (uint32_t i = 0; i < count; i++) {
+    start_times[i] = records[i].start_time;
+    durations[i] = records[i].seconds_elapsed;
+  }
+
+  int error = log_file_write(log_path, start_times, durations, count, sync_sequence);
+  if (error != 0) {
+    fprintf(stderr, "%s: %s\n", log_path, strerror(error));
+  }
+
+  free(records);
+  free(start_times);
+  free(durations);
+  return error != 0;
+}
+
+static int dump(const char *log_path) {
+  LogFile file;
+  int error = log_file_map(&file, log_path);
+  if (error != 0) {
+    fprintf(stderr, "%s: %s\n", log_path, strerror(error));
+    return 1;
+  }
+
+  printf("# %u records, %u sessions, sequence %u\n", file.count, file.number_of_sessions, file.sync_sequence);
+  for (uint32_t i = 0; i < file.number_of_sessions; i++) {
+    LogSession session;
+    log_file_session(&file, i, &session);
+    printf("# session %u: first %u count %u from %u to %u duration %u interval %u\n", i, session.first_index,
+      session.count, session.start_time, session.end_time, session.total_duration_in_seconds, session.total_interval_in_seconds);
+  }
+  for (uint32_t i = 0; i < file.count; i++) {
+    printf("%u\t%u\n", log_file_start_time(&file, i), log_file_duration(&file, i));
+  }
+
+  log_file_unmap(&file);
+  return 0;
+}
+
+static void print_usage(const char *name) {
+  fprintf(stderr, "usage: %s [-s sequence] records log\n       %s -d log\n", name, name);
+}
+
+// Non-static functions
+int main(int argc, char **argv) {
+  bool should_dump = false;
+  uint32_t sync_sequence = 0;
+
+  int option;
+  while ((option = getopt(argc, argv, "ds:")) != -1) {
+    switch (option) {
+      case 'd':
+        should_dump = true;
+        break;
+      case 's':
+        sync_sequence = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        print_usage(argv[0]);
+        return 2;
+    }
+  }
+
+  if (should_dump && argc - optind == 1) {
+    return dump(argv[optind]);
+  }
+  if (!should_dump && argc - optind == 2) {
+    return pack(argv[optind], argv[optind + 1], sync_sequence);
+  }
+  print_usage(argv[0]);
+  return 2;
+}
\ No newline at end of file